@@ -0,0 +1,77 @@
+#ifndef _HIT_SET_H
+#define _HIT_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define HIT_BLOCK_BYTES 240
+
+
+// A run of ascending hit addresses. The first address is stored in base, the
+// rest as LEB128 encoded deltas from the previous address in data. Dense
+// scans need one byte per hit instead of eight.
+typedef struct hit_block {
+    size_t base;
+    uint32_t count;
+    uint32_t size;
+    uint8_t data[HIT_BLOCK_BYTES];
+} hit_block_t;
+
+
+typedef struct hit_set {
+    hit_block_t *blocks;
+    size_t block_count;
+    size_t block_capacity;
+    size_t count;
+    size_t last;
+    // Times the block array was reallocated
+    size_t realloc_count;
+} hit_set_t;
+
+
+// Last known value of every hit of a hit set, value_size bytes each in hit
+// order. Kept apart from the addresses so passes over the values stay
+// contiguous.
+typedef struct value_column {
+    uint8_t *data;
+    size_t count;
+    size_t capacity;
+    size_t value_size;
+    // Times the data was reallocated
+    size_t realloc_count;
+} value_column_t;
+
+
+typedef struct hit_iter {
+    const hit_set_t *set;
+    size_t block;
+    uint32_t index;
+    uint32_t position;
+    size_t address;
+} hit_iter_t;
+
+
+void hit_set_init(hit_set_t *set);
+void hit_set_clear(hit_set_t *set);
+bool hit_set_append(hit_set_t *set, size_t address);
+bool hit_set_concat(hit_set_t *set, const hit_set_t *other);
+bool hit_set_copy(hit_set_t *dst, const hit_set_t *src);
+size_t hit_set_get(const hit_set_t *set, size_t index);
+void hit_set_remove(hit_set_t *set, size_t index);
+size_t hit_set_bytes(const hit_set_t *set);
+
+void value_column_init(value_column_t *column, size_t value_size);
+void value_column_clear(value_column_t *column);
+bool value_column_append(value_column_t *column, const void *value);
+bool value_column_concat(value_column_t *column, const value_column_t *other);
+bool value_column_copy(value_column_t *dst, const value_column_t *src);
+void value_column_remove(value_column_t *column, size_t index);
+const uint8_t *value_column_get(const value_column_t *column, size_t index);
+
+void hit_iter_start(hit_iter_t *iter, const hit_set_t *set);
+bool hit_iter_next(hit_iter_t *iter, size_t *address);
+
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _JOB_POOL_H
+#define _JOB_POOL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "maps.h"
+
+
+// Largest piece of a region a single worker reads
+#define REGION_JOB_SIZE (16 * 1024 * 1024)
+
+
+// Piece of one region of the subject's memory
+typedef struct region_job {
+    size_t offset;
+    size_t size;
+    // Readable bytes of the region past the end of the job, for values and
+    // patterns that straddle it
+    size_t overlap;
+    // Picked up by the workers before every other job
+    bool priority;
+    // Private anonymous memory, where pages missing from the pagemap are zero
+    bool anonymous;
+    // Last job of its region
+    bool last;
+} region_job_t;
+
+
+// Runs job number job of the caller's jobs, returning false fails the pool
+typedef bool (*job_run_t)(void *context, size_t job);
+
+
+// Hands out job indices to worker threads. Worker 0 runs on the calling
+// thread, the pool stops handing out jobs once one of them fails.
+typedef struct job_pool {
+    job_run_t run;
+    void *context;
+    size_t job_count;
+    // Order in which the workers pick up jobs, NULL for ascending order
+    const size_t *order;
+    atomic_size_t next_job;
+    atomic_bool failed;
+} job_pool_t;
+
+
+bool job_pool_run(job_pool_t *pool, size_t worker_count);
+bool push_region_jobs(region_job_t **jobs, size_t *job_count, size_t *job_capacity, size_t offset, size_t size, bool priority, bool anonymous);
+region_job_t *split_regions(const maps_t *maps, const region_policy_t *policy, size_t *job_count);
+
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "subject.h"
+
+
+// Compares count values stride bytes apart in buffer against needle and sets
+// bit i of mask when value i matches. Writes kernel_mask_words(count) words.
+// For relative ops the needle is an array of count previous values instead,
+// laid out with the same stride.
+typedef void (*mask_kernel_t)(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask);
+
+// Compares the single value at value against needle.
+typedef bool (*compare_kernel_t)(const void *value, const void *needle);
+
+// Stores the smallest and largest of count values stride bytes apart in
+// buffer to min and max. count must not be 0. NaNs are skipped, so min is
+// left above max when every value is NaN.
+typedef void (*range_kernel_t)(const uint8_t *buffer, size_t count, size_t stride, void *min, void *max);
+
+
+// One fully specialized pair of functions per scan_type_e, search_op_e and
+// stride class (natural, byte or any other).
+// SEARCH_APPROX accepts values within 1.5 of the needle for floats and
+// within 1 for integers.
+// SCANTYPE_STRING and SCANTYPE_GROUP only have SEARCH_NOOP and SEARCH_EQUAL
+// kernels, the others are NULL. Their needle is the scan's scan_string_t or
+// scan_group_t, a group matches when every one of its fields does.
+typedef struct scan_kernel {
+    mask_kernel_t mask;
+    compare_kernel_t compare;
+} scan_kernel_t;
+
+
+scan_kernel_t kernel_select(scan_type_e type, search_op_e op, size_t stride);
+// NULL for strings and groups
+range_kernel_t range_kernel_select(scan_type_e type);
+bool search_op_is_relative(search_op_e op);
+size_t kernel_mask_words(size_t count);
+
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _MAPS_H
+#define _MAPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+
+typedef struct region
+{
+    size_t offset;
+    size_t size;
+    bool read;
+    bool write;
+    bool exec;
+    bool shared;
+    size_t file_offset;
+    unsigned long inode;
+    // Points into maps_t::text, empty for anonymous mappings
+    const char *filename;
+} region_t;
+
+
+typedef struct maps {
+    region_t *regions;
+    size_t region_count;
+    char *text;
+} maps_t;
+
+
+typedef enum region_kind_e {
+    REGION_HEAP = 1 << 0,
+    REGION_STACK = 1 << 1,
+    // No backing file, including named [anon:...] mappings
+    REGION_ANONYMOUS = 1 << 2,
+    // Backed by a file: executables, shared libraries and mapped files
+    REGION_MODULE = 1 << 3,
+    // Kernel provided mappings such as [vdso] and [vvar]
+    REGION_SPECIAL = 1 << 4,
+} region_kind_e;
+
+#define REGION_ALL (REGION_HEAP | REGION_STACK | REGION_ANONYMOUS | REGION_MODULE | REGION_SPECIAL)
+
+
+// Decides which regions a scan reads and in which order
+typedef struct region_policy {
+    // Bitmask of region_kind_e
+    unsigned kinds;
+    // fnmatch pattern that module regions must match, either the full path
+    // or the file name. NULL for every module.
+    char *module;
+    // Only readable and writable regions
+    bool writable;
+    // Bounds on the size of the whole region, a max of 0 is unbounded
+    size_t min_size;
+    size_t max_size;
+    // Regions are clipped to [min_address, max_address), a max of 0 is
+    // unbounded
+    size_t min_address;
+    size_t max_address;
+    // Heap regions are scanned before every other region
+    bool heap_first;
+} region_policy_t;
+
+
+maps_t *read_maps(pid_t pid);
+void print_maps(maps_t *maps);
+void free_maps(maps_t *maps);
+
+void region_policy_init(region_policy_t *policy);
+region_kind_e region_kind(const region_t *region);
+bool region_policy_apply(const region_policy_t *policy, const region_t *region, size_t *offset, size_t *size);
+bool region_policy_prioritized(const region_policy_t *policy, const region_t *region);
+bool region_zero_filled(const region_t *region);
+
+
+#endif
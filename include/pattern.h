@@ -0,0 +1,70 @@
+#ifndef _PATTERN_H
+#define _PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define PATTERN_MAX_SIZE 256
+// Longest run of exact bytes the automaton matches before the rest of a
+// pattern is compared
+#define PATTERN_ANCHOR_MAX 16
+
+
+// Array of bytes signature. A byte of memory matches byte i of the pattern
+// when (byte & mask[i]) == bytes[i], so a mask of 0 is a wildcard byte and
+// 0xf0 or 0x0f a wildcard nibble.
+typedef struct pattern {
+    uint8_t *bytes;
+    uint8_t *mask;
+    size_t size;
+    // Longest run of bytes without wildcards, the part the automaton finds
+    size_t anchor_offset;
+    size_t anchor_size;
+    // Next pattern with the same anchor, -1 for none
+    int32_t next;
+} pattern_t;
+
+
+typedef struct pattern_state {
+    // First pattern whose anchor ends in this state, -1 for none
+    int32_t patterns;
+    // Nearest state along the failure links that has patterns, -1 for none
+    int32_t output;
+} pattern_state_t;
+
+
+// Aho-Corasick automaton over the anchors of several patterns, so memory is
+// searched for all of them in one pass. Every state has a full row of 256
+// transitions, a transition into a state that ends an anchor is stored as
+// its bitwise complement.
+typedef struct pattern_set {
+    pattern_t *patterns;
+    size_t count;
+    size_t max_size;
+    int32_t *transitions;
+    pattern_state_t *states;
+    size_t state_count;
+    // Bytes that leave the root state. Memory is skipped ahead to the next
+    // one of them while the automaton is in the root state.
+    bool first[256];
+    uint8_t first_bytes[256];
+    size_t first_byte_count;
+    size_t (*skip)(const struct pattern_set *set, const uint8_t *buffer, size_t size, size_t position);
+    // Whether a run of zero bytes can hold a match
+    bool zero_matches;
+} pattern_set_t;
+
+
+// Receives the start of one match of pattern in the searched buffer.
+// Returning false stops the search.
+typedef bool (*pattern_match_callback_t)(void *context, size_t pattern, size_t position);
+
+
+pattern_set_t *pattern_set_compile(const char *const *texts, size_t count);
+bool pattern_set_search(const pattern_set_t *set, const uint8_t *buffer, size_t size, size_t from, pattern_match_callback_t callback, void *context);
+void pattern_set_free(pattern_set_t *set);
+
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _POINTER_MAP_H
+#define _POINTER_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "maps.h"
+#include "subject.h"
+
+
+#define POINTER_MAX_DEPTH 16
+
+
+// A pointer found in the subject's memory: the value stored at address
+typedef struct pointer_entry {
+    uint64_t target;
+    uint64_t address;
+} pointer_entry_t;
+
+
+// Range of memory that belongs to a module, including the anonymous .bss
+// mapping that directly follows its file mappings. Offsets into a module
+// are taken from base, its lowest mapping.
+typedef struct pointer_module {
+    size_t start;
+    size_t end;
+    size_t base;
+    // Points into pointer_map_t::maps
+    const char *filename;
+} pointer_module_t;
+
+
+// Reverse index of every aligned pointer in the subject's writable regions
+// that points into a mapped region, sorted by target so all pointers into
+// a range are found with one binary search
+typedef struct pointer_map {
+    pointer_entry_t *entries;
+    size_t count;
+    pointer_module_t *modules;
+    size_t module_count;
+    maps_t *maps;
+} pointer_map_t;
+
+
+typedef struct pointer_scan_options {
+    // Pointers followed from a module to the target, at most
+    // POINTER_MAX_DEPTH
+    unsigned max_depth;
+    // Largest offset added to a pointer at each level
+    size_t max_offset;
+    // Limits on the paths reported and the addresses visited
+    size_t max_results;
+    size_t max_nodes;
+} pointer_scan_options_t;
+
+
+// Receives one path: read the pointer at module base + module_offset, add
+// offsets[0] and read again, and so on. Adding the last offset gives the
+// target. Returning false stops the search.
+typedef bool (*pointer_path_callback_t)(void *context, const pointer_module_t *module, size_t module_offset, const size_t *offsets, size_t depth);
+
+
+pointer_map_t *pointer_map_build(subject_t *subject);
+size_t pointer_map_lower_bound(const pointer_map_t *map, uint64_t target);
+const pointer_module_t *pointer_map_module(const pointer_map_t *map, size_t address);
+void pointer_scan_options_init(pointer_scan_options_t *options);
+bool pointer_map_find_paths(const pointer_map_t *map, size_t address, const pointer_scan_options_t *options, pointer_path_callback_t callback, void *context);
+void pointer_map_free(pointer_map_t *map);
+
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _SCAN_FILE_H
+#define _SCAN_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "maps.h"
+
+
+// Scan result files hold a header, the subject's region table, the region
+// names and then one fixed size record per hit, sorted by address. All
+// fields are in host byte order and every section is 8 byte aligned, so a
+// mapped file can be indexed in place.
+#define SCAN_FILE_MAGIC "MEMGREM\x01"
+#define SCAN_FILE_VERSION 1
+
+#define SCAN_FILE_READ (1u << 0)
+#define SCAN_FILE_WRITE (1u << 1)
+#define SCAN_FILE_EXEC (1u << 2)
+#define SCAN_FILE_SHARED (1u << 3)
+
+
+typedef struct scan_file_header {
+    char magic[8];
+    uint32_t version;
+    // scan_type_e of every record
+    uint32_t type;
+    uint64_t alignment;
+    int64_t pid;
+    uint64_t region_count;
+    uint64_t names_size;
+    uint64_t record_count;
+    uint64_t records_offset;
+} scan_file_header_t;
+
+
+typedef struct scan_file_region {
+    uint64_t start;
+    uint64_t end;
+    uint64_t file_offset;
+    // SCAN_FILE_* flags
+    uint32_t flags;
+    // Offset of the NUL terminated name in the names section
+    uint32_t name;
+} scan_file_region_t;
+
+
+typedef struct scan_file_record {
+    uint64_t address;
+    // Last value read, zero padded past the type's size
+    uint8_t value[8];
+} scan_file_record_t;
+
+
+typedef struct scan_writer {
+    FILE *file;
+    scan_file_header_t header;
+    uint64_t last_address;
+} scan_writer_t;
+
+
+// Read only view of a mapped scan file
+typedef struct scan_file {
+    void *data;
+    size_t size;
+    const scan_file_header_t *header;
+    const scan_file_region_t *regions;
+    const char *names;
+    const scan_file_record_t *records;
+} scan_file_t;
+
+
+bool scan_writer_open(scan_writer_t *writer, const char *path, uint32_t type, size_t alignment, pid_t pid, const maps_t *maps);
+bool scan_writer_write(scan_writer_t *writer, const scan_file_record_t *records, size_t count);
+bool scan_writer_close(scan_writer_t *writer);
+
+scan_file_t *scan_file_open(const char *path);
+const scan_file_region_t *scan_file_region(const scan_file_t *file, uint64_t address);
+const char *scan_file_region_name(const scan_file_t *file, const scan_file_region_t *region);
+void scan_file_close(scan_file_t *file);
+
+
+#endif
@@ -7,6 +7,11 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "hit_set.h"
+#include "maps.h"
+#include "pattern.h"
+#include "scan_file.h"
+
 
 typedef enum scan_type {
     SCANTYPE_UINT8,
@@ -19,6 +24,10 @@ typedef enum scan_type {
     SCANTYPE_INT64,
     SCANTYPE_FLOAT32,
     SCANTYPE_FLOAT64,
+    // Sized by the scan's string, see subject_begin_string_scan
+    SCANTYPE_STRING,
+    // Several fields of a structure, see subject_begin_group_scan
+    SCANTYPE_GROUP,
 } scan_type_e;
 
 
@@ -36,20 +45,119 @@ typedef union scan_value {
 } scan_value_u;
 
 
+// Alignments for subject_begin_scan, any other non-zero value is used as is
+#define SCAN_ALIGN_NATURAL 0
+#define SCAN_ALIGN_BYTE 1
+
+// Longest encoded string a string scan can search for
+#define SCAN_STRING_MAX 256
+// Limits of a group scan: fields per group and bytes from the base of the
+// structure to the end of its last field
+#define SCAN_GROUP_MAX_FIELDS 16
+#define SCAN_GROUP_MAX_SIZE 256
+
+
+typedef enum string_encoding_e {
+    // Also covers ASCII
+    STRING_UTF8,
+    // Little endian
+    STRING_UTF16,
+} string_encoding_e;
+
+
+// Encoded needle of a string scan. A byte of memory matches byte i when
+// (byte | fold[i]) == bytes[i]. fold is 0x20 for ASCII letters of a case
+// insensitive needle, whose bytes are stored in lower case, and 0 for every
+// other byte.
+typedef struct scan_string {
+    string_encoding_e encoding;
+    bool ignore_case;
+    size_t size;
+    uint8_t bytes[SCAN_STRING_MAX];
+    uint8_t fold[SCAN_STRING_MAX];
+} scan_string_t;
+
+
+// Counters for the work done for a subject or for a single scan, times are
+// in nanoseconds. A first pass shared by several scans counts its reads for
+// each of them but only once for the subject. Stops are only counted for the
+// subject.
+typedef struct scan_stats {
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t syscalls;
+    uint64_t stop_count;
+    uint64_t stop_ns;
+    uint64_t region_count;
+    uint64_t region_ns;
+    uint64_t region_max_ns;
+    uint64_t compare_ns;
+    uint64_t hits;
+    uint64_t reallocs;
+} scan_stats_t;
+
+
 typedef struct subject {
     pid_t pid;
+    // Freeze thread, running once the first scan_freeze call started it
     pthread_t thread_id;
+    bool freeze_running;
+    bool freeze_stopping;
+    // Ticks are skipped while a stop is under dirty tracking, see
+    // freeze_pause
+    bool freeze_paused;
+    unsigned freeze_interval_ms;
+    pthread_mutex_t freeze_lock;
+    pthread_cond_t freeze_wake;
+    struct freeze *freezes;
+    size_t worker_count;
+    // Kept open for the lifetime of the subject
+    int memory_fd;
+    // Nesting depth of subject_stop calls, the subject is ptrace stopped
+    // while this is non-zero
+    unsigned stop_depth;
+    // Live subjects are read and written without ever being stopped
+    bool live;
+    region_policy_t policy;
+    // Soft-dirty tracking, see subject_set_dirty_tracking
+    bool dirty_tracking;
+    int pagemap_fd;
+    int clear_refs_fd;
+    unsigned dirty_epoch;
+    // Scans were synced during the current stop, the bits are cleared once
+    // when it ends
+    bool dirty_clear_pending;
+    scan_stats_t stats;
+    // When the current stop began
+    uint64_t stop_start;
     struct scan *scans;
+    // Background scan started by subject_update_scans_async, NULL once it
+    // was collected by subject_wait_scan
+    struct async_scan *async;
 } subject_t;
 
 
 typedef struct scan {
     struct subject *subject;
     scan_type_e type;
-    size_t *hits;
-    size_t hit_count;
-    size_t hit_capacity;
-    scan_value_u values[32];
+    // Distance between candidate addresses, every hit is a multiple of it
+    size_t alignment;
+    hit_set_t hits;
+    // Value of every hit as of the last pass
+    value_column_t values;
+    // Needle of a SCANTYPE_STRING scan, NULL for the other types
+    scan_string_t *string;
+    // Needle of a SCANTYPE_GROUP scan, NULL for the other types
+    struct scan_group *group;
+    bool searched;
+    // Shared by every scan it was taken for, see subject_snapshot_scans
+    struct snapshot *snapshot;
+    // Zone map over the snapshot built by scan_build_index, or NULL
+    struct zone *zones;
+    // Subject dirty epoch in which the snapshot or the values of the hits
+    // were last synced
+    unsigned dirty_epoch;
+    scan_stats_t stats;
     struct scan *next;
     struct scan *prev;
 } scan_t;
@@ -61,22 +169,104 @@ typedef enum search_op_e {
     SEARCH_LESS,
     SEARCH_GREATER,
     SEARCH_APPROX,
+    // Relative ops compare each value against its previous value and take
+    // no value argument. A first pass needs a snapshot taken with
+    // scan_snapshot, later passes compare against the scan's values.
+    SEARCH_CHANGED,
+    SEARCH_UNCHANGED,
+    SEARCH_INCREASED,
+    SEARCH_DECREASED,
 } search_op_e;
 
 
+// One known field of a structure: the value of type at offset from the base
+// compared with op, which is one of SEARCH_EQUAL, SEARCH_LESS,
+// SEARCH_GREATER and SEARCH_APPROX
+typedef struct scan_field {
+    size_t offset;
+    scan_type_e type;
+    search_op_e op;
+    scan_value_u value;
+} scan_field_t;
+
+
+// Needle of a group scan. Every field has to match at the same base
+// address. Fields are kept in the order they are checked, the one expected
+// to match the fewest values first.
+typedef struct scan_group {
+    scan_field_t fields[SCAN_GROUP_MAX_FIELDS];
+    size_t field_count;
+    size_t size;
+} scan_group_t;
+
+
+// Receives hits in ascending address order with the values they had when
+// last searched, returning false stops the stream
+typedef bool (*scan_record_callback_t)(void *context, const scan_file_record_t *records, size_t count);
+
+// Receives hits of a background scan as soon as a piece of memory has been
+// searched. Called from scan worker threads, one call at a time, ascending
+// within a call but in no particular order across calls.
+typedef void (*scan_hits_callback_t)(void *context, scan_t *scan, const scan_file_record_t *records, size_t count);
+
+
+// Progress of a background scan. Totals grow as each pass of the scan
+// starts, a first pass counts memory and regions, a filter pass counts the
+// bytes of the hits it narrows.
+typedef struct scan_progress {
+    uint64_t bytes_done;
+    uint64_t bytes_total;
+    uint64_t regions_done;
+    uint64_t region_count;
+    uint64_t hits;
+    bool running;
+    bool cancelled;
+} scan_progress_t;
+
+
 subject_t *subject_create(pid_t pid);
-scan_t *subject_begin_scan(subject_t *subject, scan_type_e type);
+bool subject_stop(subject_t *subject);
+bool subject_resume(subject_t *subject);
+bool subject_set_live(subject_t *subject, bool live);
+bool subject_set_region_policy(subject_t *subject, const region_policy_t *policy);
+bool subject_set_dirty_tracking(subject_t *subject, bool enabled);
+void subject_reset_stats(subject_t *subject);
+void subject_add_stats(subject_t *subject, const scan_stats_t *stats);
+void subject_set_freeze_interval(subject_t *subject, unsigned milliseconds);
+void print_stats(const char *name, const scan_stats_t *stats);
+uint64_t clock_ns(void);
+bool subject_update_scans(subject_t *subject, scan_t **scans, const scan_value_u *values, size_t scan_count, search_op_e op);
+bool subject_update_scans_async(subject_t *subject, scan_t **scans, const scan_value_u *values, size_t scan_count, search_op_e op, scan_hits_callback_t callback, void *context);
+bool subject_scan_progress(subject_t *subject, scan_progress_t *progress);
+void subject_cancel_scan(subject_t *subject);
+bool subject_wait_scan(subject_t *subject);
+bool subject_snapshot_scans(subject_t *subject, scan_t **scans, size_t scan_count);
+bool subject_find_patterns(subject_t *subject, const pattern_set_t *set, hit_set_t *hits);
+scan_t *subject_begin_scan(subject_t *subject, scan_type_e type, size_t alignment);
+scan_t *subject_begin_string_scan(subject_t *subject, const char *text, string_encoding_e encoding, bool ignore_case);
+scan_t *subject_begin_group_scan(subject_t *subject, const scan_field_t *fields, size_t field_count, size_t alignment);
+scan_t *subject_import_scan(subject_t *subject, const char *path);
 void subject_free(subject_t *subject);
 
 scan_t *scan_fork(scan_t *scan);
 bool scan_set_value(scan_t *scan, ...);
+bool scan_freeze(scan_t *scan, ...);
+void scan_unfreeze(scan_t *scan);
+bool scan_snapshot(scan_t *scan);
+bool scan_build_index(scan_t *scan);
+bool scan_refresh_index(scan_t *scan);
+scan_t *scan_query(scan_t *scan, const search_op_e *ops, const scan_value_u *values, size_t op_count);
 bool scan_update(scan_t *scan, search_op_e op, ...);
 void scan_eliminate(scan_t *scan, size_t index);
 bool scan_refresh(scan_t *scan);
 void scan_print(scan_t *scan);
+bool scan_stream(scan_t *scan, scan_record_callback_t callback, void *context);
+bool scan_export(scan_t *scan, const char *path);
 void scan_free(scan_t *scan);
 
+scan_value_u scan_get_value(const scan_t *scan, size_t index);
 size_t scan_type_size(scan_type_e type);
+scan_value_u scan_value_from_double(scan_type_e type, double number);
 
 
 #endif
@@ -0,0 +1,352 @@
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "maps.h"
+#include "subject.h"
+
+
+#define BENCH_FLOAT_VALUE 1234.5f
+#define BENCH_INT_VALUE 123456789
+
+
+typedef struct bench_options {
+    size_t heap_mb;
+    double density;
+    double float_ratio;
+    size_t mapping_count;
+    size_t iterations;
+    size_t alignment;
+    size_t worker_count;
+} bench_options_t;
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [--heap-mb N] [--density D] [--float-ratio R] [--mappings N] [--iterations N] [--alignment N] [--workers N]\n", name);
+}
+
+
+static bool parse_options(int argc, char **argv, bench_options_t *options) {
+    options->heap_mb = 256;
+    options->density = 0.001;
+    options->float_ratio = 0.5;
+    options->mapping_count = 16;
+    options->iterations = 3;
+    options->alignment = SCAN_ALIGN_NATURAL;
+    options->worker_count = 0;
+
+    for (int i=1; i < argc; i++) {
+        if (i + 1 == argc) {
+            fprintf(stderr, "error: missing value for '%s'\n", argv[i]);
+            return false;
+        }
+        const char *name = argv[i];
+        char *end;
+        double value = strtod(argv[++i], &end);
+        if (*end != '\0' || value < 0) {
+            fprintf(stderr, "error: invalid value '%s' for '%s'\n", argv[i], name);
+            return false;
+        }
+
+        if (strcmp(name, "--heap-mb") == 0) {
+            options->heap_mb = (size_t)value;
+        } else if (strcmp(name, "--density") == 0) {
+            options->density = value;
+        } else if (strcmp(name, "--float-ratio") == 0) {
+            options->float_ratio = value;
+        } else if (strcmp(name, "--mappings") == 0) {
+            options->mapping_count = (size_t)value;
+        } else if (strcmp(name, "--iterations") == 0) {
+            options->iterations = (size_t)value;
+        } else if (strcmp(name, "--alignment") == 0) {
+            options->alignment = (size_t)value;
+        } else if (strcmp(name, "--workers") == 0) {
+            options->worker_count = (size_t)value;
+        } else {
+            fprintf(stderr, "error: unknown option '%s'\n", name);
+            return false;
+        }
+    }
+
+    if (options->heap_mb == 0 || options->mapping_count == 0 || options->iterations == 0) {
+        fprintf(stderr, "error: heap size, mapping count and iterations must be non-zero\n");
+        return false;
+    }
+    return true;
+}
+
+
+static uint64_t xorshift(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+
+// Child side: fills its mappings with noise and plants the float and int
+// needles at the requested density, then reports ready and waits to be
+// killed
+static void run_subject(const bench_options_t *options, int ready_fd) {
+    size_t mapping_size = options->heap_mb * 1024 * 1024 / options->mapping_count;
+    mapping_size = (mapping_size + 4095) & ~(size_t)4095;
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    uint64_t density_threshold = (uint64_t)(options->density * (double)UINT32_MAX);
+    uint64_t float_threshold = (uint64_t)(options->float_ratio * (double)UINT32_MAX);
+
+    for (size_t i=0; i < options->mapping_count; i++) {
+        uint32_t *mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            fprintf(stderr, "error: failed to map subject memory: %s\n", strerror(errno));
+            _exit(1);
+        }
+        // Alternate protections so neighbouring mappings are not merged
+        if (i % 2 == 1) {
+            mprotect(mapping, 4096, PROT_READ);
+        }
+        size_t start = (i % 2 == 1) ? 4096 / sizeof(uint32_t) : 0;
+        for (size_t j=start; j < mapping_size / sizeof(uint32_t); j++) {
+            uint64_t random = xorshift(&state);
+            if ((random & UINT32_MAX) >= density_threshold) {
+                // Noise below 2^24 is never a float needle or the int needle
+                mapping[j] = (uint32_t)(random >> 40);
+            } else if ((random >> 32) < float_threshold) {
+                float value = BENCH_FLOAT_VALUE;
+                memcpy(&mapping[j], &value, sizeof(float));
+            } else {
+                mapping[j] = BENCH_INT_VALUE;
+            }
+        }
+    }
+
+    char ready = 1;
+    if (write(ready_fd, &ready, 1) != 1) {
+        _exit(1);
+    }
+    while (true) {
+        pause();
+    }
+}
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+static void report(const char *phase, size_t iterations, double seconds, size_t bytes, size_t hits) {
+    double gb_per_s = (seconds > 0) ? (double)bytes / seconds / 1e9 : 0;
+    double hits_per_s = (seconds > 0) ? (double)hits / seconds : 0;
+    printf("%s,%zu,%.6f,%zu,%zu,%.3f,%.0f\n", phase, iterations, seconds, bytes, hits, gb_per_s, hits_per_s);
+    fflush(stdout);
+}
+
+
+// Bytes a first pass reads under the subject's region policy
+static size_t scanned_bytes(subject_t *subject) {
+    maps_t *maps = read_maps(subject->pid);
+    if (maps == NULL) {
+        return 0;
+    }
+    size_t total = 0;
+    for (size_t i=0; i < maps->region_count; i++) {
+        size_t offset, size;
+        if (region_policy_apply(&subject->policy, &maps->regions[i], &offset, &size)) {
+            total += size;
+        }
+    }
+    free_maps(maps);
+    return total;
+}
+
+
+static bool bench_read_maps(subject_t *subject, const bench_options_t *options) {
+    size_t iterations = options->iterations * 100;
+    size_t regions = 0;
+    double start = now();
+    for (size_t i=0; i < iterations; i++) {
+        maps_t *maps = read_maps(subject->pid);
+        if (maps == NULL) {
+            return false;
+        }
+        regions += maps->region_count;
+        free_maps(maps);
+    }
+    // Regions parsed count as hits
+    report("read_maps", iterations, now() - start, 0, regions);
+    return true;
+}
+
+
+// Times the first pass of a fresh scan, then a narrowing pass over its hits
+// and a write of every hit
+static bool bench_scan(subject_t *subject, const bench_options_t *options, const char *name, scan_type_e type, double needle, size_t bytes) {
+    char phase[64];
+    double search_seconds = 0, filter_seconds = 0, set_seconds = 0;
+    size_t search_hits = 0, filter_hits = 0, set_hits = 0;
+
+    for (size_t i=0; i < options->iterations; i++) {
+        scan_t *scan = subject_begin_scan(subject, type, options->alignment);
+        if (scan == NULL) {
+            return false;
+        }
+        scan_value_u value = scan_value_from_double(type, needle);
+
+        double start = now();
+        if (!subject_update_scans(subject, &scan, &value, 1, SEARCH_EQUAL)) {
+            scan_free(scan);
+            return false;
+        }
+        search_seconds += now() - start;
+        search_hits += scan->hits.count;
+
+        start = now();
+        if (!subject_update_scans(subject, &scan, &value, 1, SEARCH_EQUAL)) {
+            scan_free(scan);
+            return false;
+        }
+        filter_seconds += now() - start;
+        filter_hits += scan->hits.count;
+
+        start = now();
+        bool set_result = (type == SCANTYPE_FLOAT32 || type == SCANTYPE_FLOAT64)
+            ? scan_set_value(scan, needle)
+            : scan_set_value(scan, (int32_t)needle);
+        if (!set_result) {
+            scan_free(scan);
+            return false;
+        }
+        set_seconds += now() - start;
+        set_hits += scan->hits.count;
+
+        scan_free(scan);
+    }
+
+    snprintf(phase, sizeof(phase), "search_%s", name);
+    report(phase, options->iterations, search_seconds, bytes * options->iterations, search_hits);
+    snprintf(phase, sizeof(phase), "filter_%s", name);
+    report(phase, options->iterations, filter_seconds, filter_hits * scan_type_size(type), filter_hits);
+    snprintf(phase, sizeof(phase), "set_%s", name);
+    report(phase, options->iterations, set_seconds, set_hits * scan_type_size(type), set_hits);
+    return true;
+}
+
+
+// Times a float and an int scan sharing one first pass
+static bool bench_multi_scan(subject_t *subject, const bench_options_t *options, size_t bytes) {
+    double seconds = 0;
+    size_t hits = 0;
+
+    for (size_t i=0; i < options->iterations; i++) {
+        scan_t *scans[2] = {
+            subject_begin_scan(subject, SCANTYPE_FLOAT32, options->alignment),
+            subject_begin_scan(subject, SCANTYPE_INT32, options->alignment),
+        };
+        if (scans[0] == NULL || scans[1] == NULL) {
+            scan_free(scans[0]);
+            scan_free(scans[1]);
+            return false;
+        }
+        scan_value_u values[2] = {
+            scan_value_from_double(SCANTYPE_FLOAT32, BENCH_FLOAT_VALUE),
+            scan_value_from_double(SCANTYPE_INT32, BENCH_INT_VALUE),
+        };
+
+        double start = now();
+        if (!subject_update_scans(subject, scans, values, 2, SEARCH_EQUAL)) {
+            scan_free(scans[0]);
+            scan_free(scans[1]);
+            return false;
+        }
+        seconds += now() - start;
+        hits += scans[0]->hits.count + scans[1]->hits.count;
+
+        scan_free(scans[0]);
+        scan_free(scans[1]);
+    }
+
+    report("search_multi", options->iterations, seconds, bytes * options->iterations, hits);
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (!parse_options(argc, argv, &options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int ready_pipe[2];
+    if (pipe(ready_pipe) == -1) {
+        fprintf(stderr, "error: failed to create pipe: %s\n", strerror(errno));
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        fprintf(stderr, "error: failed to fork subject: %s\n", strerror(errno));
+        return 1;
+    }
+    if (pid == 0) {
+        close(ready_pipe[0]);
+        run_subject(&options, ready_pipe[1]);
+    }
+    close(ready_pipe[1]);
+
+    int status = 1;
+    subject_t *subject = NULL;
+
+    char ready;
+    if (read(ready_pipe[0], &ready, 1) != 1) {
+        fprintf(stderr, "error: subject failed to start\n");
+        goto EXIT;
+    }
+
+    subject = subject_create(pid);
+    if (subject == NULL) {
+        goto EXIT;
+    }
+    if (options.worker_count != 0) {
+        subject->worker_count = options.worker_count;
+    }
+
+    // Stopped once for the whole run, so attach and detach are not timed
+    if (!subject_stop(subject)) {
+        goto EXIT;
+    }
+
+    size_t bytes = scanned_bytes(subject);
+    printf("phase,iterations,seconds,bytes,hits,gb_per_s,hits_per_s\n");
+    if (!bench_read_maps(subject, &options)) {
+        goto EXIT;
+    }
+    if (!bench_scan(subject, &options, "float32", SCANTYPE_FLOAT32, BENCH_FLOAT_VALUE, bytes)) {
+        goto EXIT;
+    }
+    if (!bench_scan(subject, &options, "int32", SCANTYPE_INT32, BENCH_INT_VALUE, bytes)) {
+        goto EXIT;
+    }
+    if (!bench_multi_scan(subject, &options, bytes)) {
+        goto EXIT;
+    }
+
+    status = 0;
+
+  EXIT:
+    subject_free(subject);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    close(ready_pipe[0]);
+    return status;
+}
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "hit_set.h"
+
+
+static uint32_t encode_delta(uint8_t *data, size_t delta) {
+    uint32_t length = 0;
+    while (delta >= 0x80) {
+        data[length++] = (uint8_t)(delta | 0x80);
+        delta >>= 7;
+    }
+    data[length++] = (uint8_t)delta;
+    return length;
+}
+
+
+static size_t decode_delta(const uint8_t *data, uint32_t *position) {
+    size_t delta = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+        byte = data[(*position)++];
+        delta |= (size_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return delta;
+}
+
+
+static uint32_t delta_length(size_t delta) {
+    uint32_t length = 1;
+    while (delta >= 0x80) {
+        delta >>= 7;
+        length++;
+    }
+    return length;
+}
+
+
+static bool reserve_blocks(hit_set_t *set, size_t block_count) {
+    if (block_count <= set->block_capacity) {
+        return true;
+    }
+    size_t new_capacity = MAX(set->block_capacity * 2, 64);
+    while (new_capacity < block_count) {
+        new_capacity *= 2;
+    }
+    hit_block_t *resized_blocks = realloc(set->blocks, new_capacity * sizeof(hit_block_t));
+    if (resized_blocks == NULL) {
+        fprintf(stderr, "error: out of memory while growing hit set\n");
+        return false;
+    }
+    set->block_capacity = new_capacity;
+    set->blocks = resized_blocks;
+    set->realloc_count++;
+    return true;
+}
+
+
+// Address of the last hit in a block, found by walking its deltas
+static size_t block_last(const hit_block_t *block) {
+    size_t address = block->base;
+    uint32_t position = 0;
+    while (position < block->size) {
+        address += decode_delta(block->data, &position);
+    }
+    return address;
+}
+
+
+void hit_set_init(hit_set_t *set) {
+    memset(set, 0, sizeof(hit_set_t));
+}
+
+
+void hit_set_clear(hit_set_t *set) {
+    free(set->blocks);
+    hit_set_init(set);
+}
+
+
+bool hit_set_append(hit_set_t *set, size_t address) {
+    if (set->block_count > 0 && address > set->last) {
+        hit_block_t *block = &set->blocks[set->block_count - 1];
+        size_t delta = address - set->last;
+        if (block->size + delta_length(delta) <= HIT_BLOCK_BYTES) {
+            block->size += encode_delta(block->data + block->size, delta);
+            block->count++;
+            set->count++;
+            set->last = address;
+            return true;
+        }
+    }
+
+    // Full block or out of order address, either way start a new run
+    if (!reserve_blocks(set, set->block_count + 1)) {
+        return false;
+    }
+    hit_block_t *block = &set->blocks[set->block_count++];
+    block->base = address;
+    block->count = 1;
+    block->size = 0;
+    set->count++;
+    set->last = address;
+    return true;
+}
+
+
+bool hit_set_concat(hit_set_t *set, const hit_set_t *other) {
+    if (other->block_count == 0) {
+        return true;
+    }
+    if (!reserve_blocks(set, set->block_count + other->block_count)) {
+        return false;
+    }
+    memcpy(set->blocks + set->block_count, other->blocks, other->block_count * sizeof(hit_block_t));
+    set->block_count += other->block_count;
+    set->count += other->count;
+    set->last = other->last;
+    return true;
+}
+
+
+bool hit_set_copy(hit_set_t *dst, const hit_set_t *src) {
+    hit_set_init(dst);
+    return hit_set_concat(dst, src);
+}
+
+
+size_t hit_set_get(const hit_set_t *set, size_t index) {
+    for (size_t i=0; i < set->block_count; i++) {
+        const hit_block_t *block = &set->blocks[i];
+        if (index >= block->count) {
+            index -= block->count;
+            continue;
+        }
+        size_t address = block->base;
+        uint32_t position = 0;
+        for (size_t j=0; j < index; j++) {
+            address += decode_delta(block->data, &position);
+        }
+        return address;
+    }
+    return 0;
+}
+
+
+void hit_set_remove(hit_set_t *set, size_t index) {
+    size_t block_index = 0;
+    while (block_index < set->block_count && index >= set->blocks[block_index].count) {
+        index -= set->blocks[block_index].count;
+        block_index++;
+    }
+    if (block_index == set->block_count) {
+        return;
+    }
+
+    // Re-encode the block without the removed hit. Merging two deltas never
+    // takes more bytes than encoding them apart, so the block always fits.
+    hit_block_t *block = &set->blocks[block_index];
+    size_t addresses[HIT_BLOCK_BYTES + 1];
+    uint32_t position = 0;
+    addresses[0] = block->base;
+    for (uint32_t i=1; i < block->count; i++) {
+        addresses[i] = addresses[i - 1] + decode_delta(block->data, &position);
+    }
+    memmove(addresses + index, addresses + index + 1, (block->count - index - 1) * sizeof(size_t));
+    block->count--;
+    set->count--;
+
+    if (block->count == 0) {
+        memmove(block, block + 1, (set->block_count - block_index - 1) * sizeof(hit_block_t));
+        set->block_count--;
+    } else {
+        block->base = addresses[0];
+        block->size = 0;
+        for (uint32_t i=1; i < block->count; i++) {
+            block->size += encode_delta(block->data + block->size, addresses[i] - addresses[i - 1]);
+        }
+    }
+
+    if (set->block_count == 0) {
+        set->last = 0;
+    } else {
+        set->last = block_last(&set->blocks[set->block_count - 1]);
+    }
+}
+
+
+size_t hit_set_bytes(const hit_set_t *set) {
+    return set->block_capacity * sizeof(hit_block_t);
+}
+
+
+static bool reserve_values(value_column_t *column, size_t count) {
+    if (count <= column->capacity) {
+        return true;
+    }
+    size_t new_capacity = MAX(column->capacity * 2, 1024);
+    while (new_capacity < count) {
+        new_capacity *= 2;
+    }
+    uint8_t *resized_data = realloc(column->data, new_capacity * column->value_size);
+    if (resized_data == NULL) {
+        fprintf(stderr, "error: out of memory while growing value column\n");
+        return false;
+    }
+    column->capacity = new_capacity;
+    column->data = resized_data;
+    column->realloc_count++;
+    return true;
+}
+
+
+void value_column_init(value_column_t *column, size_t value_size) {
+    memset(column, 0, sizeof(value_column_t));
+    column->value_size = value_size;
+}
+
+
+void value_column_clear(value_column_t *column) {
+    free(column->data);
+    value_column_init(column, column->value_size);
+}
+
+
+bool value_column_append(value_column_t *column, const void *value) {
+    if (!reserve_values(column, column->count + 1)) {
+        return false;
+    }
+    memcpy(column->data + column->count * column->value_size, value, column->value_size);
+    column->count++;
+    return true;
+}
+
+
+bool value_column_concat(value_column_t *column, const value_column_t *other) {
+    if (other->count == 0) {
+        return true;
+    }
+    if (!reserve_values(column, column->count + other->count)) {
+        return false;
+    }
+    memcpy(column->data + column->count * column->value_size, other->data, other->count * column->value_size);
+    column->count += other->count;
+    return true;
+}
+
+
+bool value_column_copy(value_column_t *dst, const value_column_t *src) {
+    value_column_init(dst, src->value_size);
+    return value_column_concat(dst, src);
+}
+
+
+void value_column_remove(value_column_t *column, size_t index) {
+    if (index >= column->count) {
+        return;
+    }
+    uint8_t *slot = column->data + index * column->value_size;
+    memmove(slot, slot + column->value_size, (column->count - index - 1) * column->value_size);
+    column->count--;
+}
+
+
+const uint8_t *value_column_get(const value_column_t *column, size_t index) {
+    return column->data + index * column->value_size;
+}
+
+
+void hit_iter_start(hit_iter_t *iter, const hit_set_t *set) {
+    iter->set = set;
+    iter->block = 0;
+    iter->index = 0;
+    iter->position = 0;
+    iter->address = 0;
+}
+
+
+bool hit_iter_next(hit_iter_t *iter, size_t *address) {
+    while (iter->block < iter->set->block_count) {
+        const hit_block_t *block = &iter->set->blocks[iter->block];
+        if (iter->index >= block->count) {
+            iter->block++;
+            iter->index = 0;
+            iter->position = 0;
+            continue;
+        }
+        if (iter->index == 0) {
+            iter->address = block->base;
+        } else {
+            iter->address += decode_delta(block->data, &iter->position);
+        }
+        iter->index++;
+        *address = iter->address;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "job_pool.h"
+
+
+static void *job_worker_main(void *arg) {
+    job_pool_t *pool = arg;
+    while (!atomic_load(&pool->failed)) {
+        size_t job_index = atomic_fetch_add(&pool->next_job, 1);
+        if (job_index >= pool->job_count) {
+            break;
+        }
+        if (pool->order != NULL) {
+            job_index = pool->order[job_index];
+        }
+        if (!pool->run(pool->context, job_index)) {
+            atomic_store(&pool->failed, true);
+        }
+    }
+    return NULL;
+}
+
+
+// Runs every job of the pool on at most worker_count threads
+bool job_pool_run(job_pool_t *pool, size_t worker_count) {
+    atomic_init(&pool->next_job, 0);
+    atomic_init(&pool->failed, false);
+    worker_count = MIN(MAX(worker_count, 1), MAX(pool->job_count, 1));
+    pthread_t *threads = calloc(worker_count, sizeof(pthread_t));
+    if (threads == NULL) {
+        fprintf(stderr, "error: out of memory while allocating workers\n");
+        return false;
+    }
+
+    size_t started_count;
+    for (started_count=1; started_count < worker_count; started_count++) {
+        int error = pthread_create(&threads[started_count], NULL, job_worker_main, pool);
+        if (error != 0) {
+            fprintf(stderr, "error: failed to start worker: %s\n", strerror(error));
+            break;
+        }
+    }
+    job_worker_main(pool);
+    for (size_t i=1; i < started_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    return !atomic_load(&pool->failed);
+}
+
+
+// Splits a region into jobs of at most REGION_JOB_SIZE. Every job but the
+// last may read into the next one for values that straddle the split.
+bool push_region_jobs(region_job_t **jobs, size_t *job_count, size_t *job_capacity, size_t offset, size_t size, bool priority, bool anonymous) {
+    for (size_t job_offset=0; job_offset < size; job_offset += REGION_JOB_SIZE) {
+        if (*job_count == *job_capacity) {
+            size_t new_capacity = MAX(*job_capacity * 2, 64);
+            region_job_t *resized_jobs = realloc(*jobs, new_capacity * sizeof(region_job_t));
+            if (resized_jobs == NULL) {
+                fprintf(stderr, "error: out of memory while allocating jobs\n");
+                return false;
+            }
+            *job_capacity = new_capacity;
+            *jobs = resized_jobs;
+        }
+        region_job_t *job = &(*jobs)[(*job_count)++];
+        job->offset = offset + job_offset;
+        job->size = MIN(size - job_offset, REGION_JOB_SIZE);
+        job->overlap = size - job_offset - job->size;
+        job->priority = priority;
+        job->anonymous = anonymous;
+        job->last = (job_offset + job->size == size);
+    }
+    return true;
+}
+
+
+// Jobs for every region the policy reads, in address order
+region_job_t *split_regions(const maps_t *maps, const region_policy_t *policy, size_t *job_count) {
+    region_job_t *jobs = NULL;
+    size_t job_capacity = 0;
+    *job_count = 0;
+    for (size_t i=0; i < maps->region_count; i++) {
+        const region_t *region = &maps->regions[i];
+        size_t offset, size;
+        if (!region_policy_apply(policy, region, &offset, &size)) {
+            continue;
+        }
+        if (!push_region_jobs(&jobs, job_count, &job_capacity, offset, size, region_policy_prioritized(policy, region), region_zero_filled(region))) {
+            free(jobs);
+            return NULL;
+        }
+    }
+    if (jobs == NULL) {
+        jobs = calloc(1, sizeof(region_job_t));
+        if (jobs == NULL) {
+            fprintf(stderr, "error: out of memory while allocating jobs\n");
+        }
+    }
+    return jobs;
+}
@@ -0,0 +1,503 @@
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+#include "kernels.h"
+
+
+// Strings and groups have kernels of their own, the tables only hold the
+// value types
+#define SCANTYPE_COUNT (SCANTYPE_FLOAT64 + 1)
+#define SEARCH_OP_COUNT (SEARCH_DECREASED + 1)
+
+#define APPROX_TOLERANCE 1.5
+
+
+// The last two columns name the unsigned type of the same width, used for
+// bitwise changed/unchanged comparisons
+#define INTEGER_SCAN_TYPES(X) \
+    X(UINT8, uint8, uint8_t, uint8_t, uint8) \
+    X(UINT16, uint16, uint16_t, uint16_t, uint16) \
+    X(UINT32, uint32, uint32_t, uint32_t, uint32) \
+    X(UINT64, uint64, uint64_t, uint64_t, uint64) \
+    X(INT8, int8, int8_t, uint8_t, uint8) \
+    X(INT16, int16, int16_t, uint16_t, uint16) \
+    X(INT32, int32, int32_t, uint32_t, uint32) \
+    X(INT64, int64, int64_t, uint64_t, uint64)
+
+#define FLOAT_SCAN_TYPES(X) \
+    X(FLOAT32, float32, float, uint32_t, uint32) \
+    X(FLOAT64, float64, double, uint64_t, uint64)
+
+
+// Per-value predicates, v is the value read from the subject and n the needle
+#define DEFINE_INTEGER_TESTS(NAME, name, ctype, utype, uname) \
+static inline bool test_##name##_equal(ctype v, ctype n) { return v == n; } \
+static inline bool test_##name##_less(ctype v, ctype n) { return v <= n; } \
+static inline bool test_##name##_greater(ctype v, ctype n) { return v >= n; } \
+static inline bool test_##name##_approx(ctype v, ctype n) { \
+    utype distance = (v > n) ? (utype)((utype)v - (utype)n) : (utype)((utype)n - (utype)v); \
+    return distance <= 1u; \
+} \
+static inline bool test_##name##_changed(ctype v, ctype n) { return v != n; } \
+static inline bool test_##name##_unchanged(ctype v, ctype n) { return v == n; } \
+static inline bool test_##name##_increased(ctype v, ctype n) { return v > n; } \
+static inline bool test_##name##_decreased(ctype v, ctype n) { return v < n; }
+
+#define DEFINE_FLOAT_TESTS(NAME, name, ctype, ...) \
+static inline bool test_##name##_equal(ctype v, ctype n) { return v == n; } \
+static inline bool test_##name##_less(ctype v, ctype n) { return v <= n; } \
+static inline bool test_##name##_greater(ctype v, ctype n) { return v >= n; } \
+static inline bool test_##name##_approx(ctype v, ctype n) { \
+    return (v >= n - (ctype)APPROX_TOLERANCE) & (v <= n + (ctype)APPROX_TOLERANCE); \
+} \
+static inline bool test_##name##_increased(ctype v, ctype n) { return v > n; } \
+static inline bool test_##name##_decreased(ctype v, ctype n) { return v < n; }
+
+INTEGER_SCAN_TYPES(DEFINE_INTEGER_TESTS)
+FLOAT_SCAN_TYPES(DEFINE_FLOAT_TESTS)
+
+
+// Mask kernels are generated once per stride: natural (stride equal to the
+// value size, the layout the vector kernels use), byte and any other stride
+// given at run time. v reads the value at index i, n the needle for it.
+#define DEFINE_MASK_KERNEL(prefix, name, ctype, op, stride_expr, needle_setup, needle_read) \
+static void prefix##_##name##_##op(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask) { \
+    (void)stride; \
+    needle_setup \
+    for (size_t word=0; word * 64 < count; word++) { \
+        size_t limit = MIN(count - word * 64, 64); \
+        uint64_t bits = 0; \
+        for (size_t j=0; j < limit; j++) { \
+            size_t i = word * 64 + j; \
+            ctype v; \
+            memcpy(&v, buffer + i * (stride_expr), sizeof(ctype)); \
+            needle_read \
+            bits |= (uint64_t)test_##name##_##op(v, n) << j; \
+        } \
+        mask[word] = bits; \
+    } \
+}
+
+#define VALUE_NEEDLE_SETUP(ctype) ctype n; memcpy(&n, needle, sizeof(ctype));
+#define PREVIOUS_NEEDLE_SETUP(ctype) const uint8_t *previous_buffer = needle;
+#define PREVIOUS_NEEDLE_READ(ctype, stride_expr) ctype n; memcpy(&n, previous_buffer + i * (stride_expr), sizeof(ctype));
+
+#define DEFINE_OP_KERNELS(name, ctype, op) \
+static bool compare_##name##_##op(const void *value, const void *needle) { \
+    ctype v, n; \
+    memcpy(&v, value, sizeof(ctype)); \
+    memcpy(&n, needle, sizeof(ctype)); \
+    return test_##name##_##op(v, n); \
+} \
+DEFINE_MASK_KERNEL(mask, name, ctype, op, sizeof(ctype), VALUE_NEEDLE_SETUP(ctype), ) \
+DEFINE_MASK_KERNEL(byte, name, ctype, op, 1, VALUE_NEEDLE_SETUP(ctype), ) \
+DEFINE_MASK_KERNEL(strided, name, ctype, op, stride, VALUE_NEEDLE_SETUP(ctype), )
+
+// Relative kernels take an array of previous values as the needle, laid out
+// with the same stride as buffer. The single-value compare is the same as
+// for value ops.
+#define DEFINE_RELATIVE_OP_KERNELS(name, ctype, op) \
+static bool compare_##name##_##op(const void *value, const void *previous) { \
+    ctype v, n; \
+    memcpy(&v, value, sizeof(ctype)); \
+    memcpy(&n, previous, sizeof(ctype)); \
+    return test_##name##_##op(v, n); \
+} \
+DEFINE_MASK_KERNEL(mask, name, ctype, op, sizeof(ctype), PREVIOUS_NEEDLE_SETUP(ctype), PREVIOUS_NEEDLE_READ(ctype, sizeof(ctype))) \
+DEFINE_MASK_KERNEL(byte, name, ctype, op, 1, PREVIOUS_NEEDLE_SETUP(ctype), PREVIOUS_NEEDLE_READ(ctype, 1)) \
+DEFINE_MASK_KERNEL(strided, name, ctype, op, stride, PREVIOUS_NEEDLE_SETUP(ctype), PREVIOUS_NEEDLE_READ(ctype, stride))
+
+#define DEFINE_TYPE_KERNELS(NAME, name, ctype, ...) \
+    DEFINE_OP_KERNELS(name, ctype, equal) \
+    DEFINE_OP_KERNELS(name, ctype, less) \
+    DEFINE_OP_KERNELS(name, ctype, greater) \
+    DEFINE_OP_KERNELS(name, ctype, approx) \
+    DEFINE_RELATIVE_OP_KERNELS(name, ctype, increased) \
+    DEFINE_RELATIVE_OP_KERNELS(name, ctype, decreased)
+
+// Changed and unchanged compare bit patterns, so only the unsigned types need them
+#define DEFINE_BITWISE_KERNELS(NAME, name, ctype, ...) \
+    DEFINE_RELATIVE_OP_KERNELS(name, ctype, changed) \
+    DEFINE_RELATIVE_OP_KERNELS(name, ctype, unchanged)
+
+INTEGER_SCAN_TYPES(DEFINE_TYPE_KERNELS)
+FLOAT_SCAN_TYPES(DEFINE_TYPE_KERNELS)
+DEFINE_BITWISE_KERNELS(UINT8, uint8, uint8_t)
+DEFINE_BITWISE_KERNELS(UINT16, uint16, uint16_t)
+DEFINE_BITWISE_KERNELS(UINT32, uint32, uint32_t)
+DEFINE_BITWISE_KERNELS(UINT64, uint64, uint64_t)
+
+
+#define DEFINE_INTEGER_RANGE_KERNEL(NAME, name, ctype, ...) \
+static void range_##name(const uint8_t *buffer, size_t count, size_t stride, void *min, void *max) { \
+    ctype low, high; \
+    memcpy(&low, buffer, sizeof(ctype)); \
+    high = low; \
+    for (size_t i=1; i < count; i++) { \
+        ctype v; \
+        memcpy(&v, buffer + i * stride, sizeof(ctype)); \
+        low = (v < low) ? v : low; \
+        high = (v > high) ? v : high; \
+    } \
+    memcpy(min, &low, sizeof(ctype)); \
+    memcpy(max, &high, sizeof(ctype)); \
+}
+
+// Comparisons with NaN are false, so NaNs never replace low or high
+#define DEFINE_FLOAT_RANGE_KERNEL(NAME, name, ctype, ...) \
+static void range_##name(const uint8_t *buffer, size_t count, size_t stride, void *min, void *max) { \
+    ctype low = (ctype)INFINITY; \
+    ctype high = -(ctype)INFINITY; \
+    for (size_t i=0; i < count; i++) { \
+        ctype v; \
+        memcpy(&v, buffer + i * stride, sizeof(ctype)); \
+        low = (v < low) ? v : low; \
+        high = (v > high) ? v : high; \
+    } \
+    memcpy(min, &low, sizeof(ctype)); \
+    memcpy(max, &high, sizeof(ctype)); \
+}
+
+INTEGER_SCAN_TYPES(DEFINE_INTEGER_RANGE_KERNEL)
+FLOAT_SCAN_TYPES(DEFINE_FLOAT_RANGE_KERNEL)
+
+#define RANGE_KERNEL_ENTRY(NAME, name, ...) [SCANTYPE_##NAME] = range_##name,
+
+static const range_kernel_t range_kernels[SCANTYPE_COUNT] = {
+    INTEGER_SCAN_TYPES(RANGE_KERNEL_ENTRY)
+    FLOAT_SCAN_TYPES(RANGE_KERNEL_ENTRY)
+};
+
+
+static bool compare_noop(const void *value, const void *needle) {
+    (void)value;
+    (void)needle;
+    return true;
+}
+
+
+static void mask_noop(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask) {
+    (void)buffer;
+    (void)stride;
+    (void)needle;
+    for (size_t word=0; word * 64 < count; word++) {
+        size_t limit = MIN(count - word * 64, 64);
+        mask[word] = (limit == 64) ? UINT64_MAX : ((1ull << limit) - 1);
+    }
+}
+
+
+#define KERNEL_ROW(prefix, NAME, name, uname) \
+    [SCANTYPE_##NAME] = { \
+        [SEARCH_NOOP] = { mask_noop, compare_noop }, \
+        [SEARCH_EQUAL] = { prefix##_##name##_equal, compare_##name##_equal }, \
+        [SEARCH_LESS] = { prefix##_##name##_less, compare_##name##_less }, \
+        [SEARCH_GREATER] = { prefix##_##name##_greater, compare_##name##_greater }, \
+        [SEARCH_APPROX] = { prefix##_##name##_approx, compare_##name##_approx }, \
+        [SEARCH_CHANGED] = { prefix##_##uname##_changed, compare_##uname##_changed }, \
+        [SEARCH_UNCHANGED] = { prefix##_##uname##_unchanged, compare_##uname##_unchanged }, \
+        [SEARCH_INCREASED] = { prefix##_##name##_increased, compare_##name##_increased }, \
+        [SEARCH_DECREASED] = { prefix##_##name##_decreased, compare_##name##_decreased }, \
+    },
+
+#define NATURAL_KERNEL_ROW(NAME, name, ctype, utype, uname) KERNEL_ROW(mask, NAME, name, uname)
+#define BYTE_KERNEL_ROW(NAME, name, ctype, utype, uname) KERNEL_ROW(byte, NAME, name, uname)
+#define STRIDED_KERNEL_ROW(NAME, name, ctype, utype, uname) KERNEL_ROW(strided, NAME, name, uname)
+
+static const scan_kernel_t scalar_kernels[SCANTYPE_COUNT][SEARCH_OP_COUNT] = {
+    INTEGER_SCAN_TYPES(NATURAL_KERNEL_ROW)
+    FLOAT_SCAN_TYPES(NATURAL_KERNEL_ROW)
+};
+
+static const scan_kernel_t byte_kernels[SCANTYPE_COUNT][SEARCH_OP_COUNT] = {
+    INTEGER_SCAN_TYPES(BYTE_KERNEL_ROW)
+    FLOAT_SCAN_TYPES(BYTE_KERNEL_ROW)
+};
+
+static const scan_kernel_t strided_kernels[SCANTYPE_COUNT][SEARCH_OP_COUNT] = {
+    INTEGER_SCAN_TYPES(STRIDED_KERNEL_ROW)
+    FLOAT_SCAN_TYPES(STRIDED_KERNEL_ROW)
+};
+
+
+#ifdef KERNELS_X86
+// Natural stride only. Whole 64-value words go through the vector loop, the
+// partial last word through the scalar kernel of the same type and op.
+#define DEFINE_SIMD_KERNEL(isa, name, ctype, op, vtype, lanes, set1, loadu, movemask, test) \
+__attribute__((target(#isa))) \
+static void isa##_##name##_##op(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask) { \
+    ctype n; \
+    memcpy(&n, needle, sizeof(ctype)); \
+    vtype vn = set1(n); \
+    vtype vlow = set1(n - (ctype)APPROX_TOLERANCE); \
+    vtype vhigh = set1(n + (ctype)APPROX_TOLERANCE); \
+    (void)vn; \
+    (void)vlow; \
+    (void)vhigh; \
+    size_t word = 0; \
+    for (; (word + 1) * 64 <= count; word++) { \
+        const ctype *values = (const ctype *)(buffer + word * 64 * sizeof(ctype)); \
+        uint64_t bits = 0; \
+        for (size_t j=0; j < 64; j += lanes) { \
+            vtype v = loadu(values + j); \
+            bits |= (uint64_t)(uint32_t)movemask(test) << j; \
+        } \
+        mask[word] = bits; \
+    } \
+    if (word * 64 < count) { \
+        mask_##name##_##op(buffer + word * 64 * sizeof(ctype), count - word * 64, stride, needle, mask + word); \
+    } \
+}
+
+#define DEFINE_SSE_KERNELS(name, ctype, vtype, lanes, suffix) \
+    DEFINE_SIMD_KERNEL(sse2, name, ctype, equal, vtype, lanes, _mm_set1_##suffix, _mm_loadu_##suffix, _mm_movemask_##suffix, \
+        _mm_cmpeq_##suffix(v, vn)) \
+    DEFINE_SIMD_KERNEL(sse2, name, ctype, less, vtype, lanes, _mm_set1_##suffix, _mm_loadu_##suffix, _mm_movemask_##suffix, \
+        _mm_cmple_##suffix(v, vn)) \
+    DEFINE_SIMD_KERNEL(sse2, name, ctype, greater, vtype, lanes, _mm_set1_##suffix, _mm_loadu_##suffix, _mm_movemask_##suffix, \
+        _mm_cmpge_##suffix(v, vn)) \
+    DEFINE_SIMD_KERNEL(sse2, name, ctype, approx, vtype, lanes, _mm_set1_##suffix, _mm_loadu_##suffix, _mm_movemask_##suffix, \
+        _mm_and_##suffix(_mm_cmpge_##suffix(v, vlow), _mm_cmple_##suffix(v, vhigh)))
+
+#define DEFINE_AVX2_KERNELS(name, ctype, vtype, lanes, suffix) \
+    DEFINE_SIMD_KERNEL(avx2, name, ctype, equal, vtype, lanes, _mm256_set1_##suffix, _mm256_loadu_##suffix, _mm256_movemask_##suffix, \
+        _mm256_cmp_##suffix(v, vn, _CMP_EQ_OQ)) \
+    DEFINE_SIMD_KERNEL(avx2, name, ctype, less, vtype, lanes, _mm256_set1_##suffix, _mm256_loadu_##suffix, _mm256_movemask_##suffix, \
+        _mm256_cmp_##suffix(v, vn, _CMP_LE_OQ)) \
+    DEFINE_SIMD_KERNEL(avx2, name, ctype, greater, vtype, lanes, _mm256_set1_##suffix, _mm256_loadu_##suffix, _mm256_movemask_##suffix, \
+        _mm256_cmp_##suffix(v, vn, _CMP_GE_OQ)) \
+    DEFINE_SIMD_KERNEL(avx2, name, ctype, approx, vtype, lanes, _mm256_set1_##suffix, _mm256_loadu_##suffix, _mm256_movemask_##suffix, \
+        _mm256_and_##suffix(_mm256_cmp_##suffix(v, vlow, _CMP_GE_OQ), _mm256_cmp_##suffix(v, vhigh, _CMP_LE_OQ)))
+
+DEFINE_SSE_KERNELS(float32, float, __m128, 4, ps)
+DEFINE_SSE_KERNELS(float64, double, __m128d, 2, pd)
+DEFINE_AVX2_KERNELS(float32, float, __m256, 8, ps)
+DEFINE_AVX2_KERNELS(float64, double, __m256d, 4, pd)
+
+
+#define SIMD_ROW(isa, NAME, name) \
+    [SCANTYPE_##NAME] = { \
+        [SEARCH_EQUAL] = isa##_##name##_equal, \
+        [SEARCH_LESS] = isa##_##name##_less, \
+        [SEARCH_GREATER] = isa##_##name##_greater, \
+        [SEARCH_APPROX] = isa##_##name##_approx, \
+    },
+
+// Vector overrides for the mask kernels, NULL entries use the scalar kernel
+static const mask_kernel_t sse2_masks[SCANTYPE_COUNT][SEARCH_OP_COUNT] = {
+    SIMD_ROW(sse2, FLOAT32, float32)
+    SIMD_ROW(sse2, FLOAT64, float64)
+};
+
+static const mask_kernel_t avx2_masks[SCANTYPE_COUNT][SEARCH_OP_COUNT] = {
+    SIMD_ROW(avx2, FLOAT32, float32)
+    SIMD_ROW(avx2, FLOAT64, float64)
+};
+#endif
+
+
+// String kernels take a scan_string_t as the needle. Positions are tested
+// on their first and last byte before the whole string is compared.
+static bool compare_string_equal(const void *value, const void *needle) {
+    const scan_string_t *string = needle;
+    const uint8_t *bytes = value;
+    for (size_t i=0; i < string->size; i++) {
+        if ((bytes[i] | string->fold[i]) != string->bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static void mask_string_equal(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask) {
+    const scan_string_t *string = needle;
+    size_t last = string->size - 1;
+    for (size_t word=0; word * 64 < count; word++) {
+        size_t limit = MIN(count - word * 64, 64);
+        uint64_t bits = 0;
+        for (size_t j=0; j < limit; j++) {
+            const uint8_t *value = buffer + (word * 64 + j) * stride;
+            if (
+                (value[0] | string->fold[0]) == string->bytes[0]
+                && (value[last] | string->fold[last]) == string->bytes[last]
+                && compare_string_equal(value, string)
+            ) {
+                bits |= 1ull << j;
+            }
+        }
+        mask[word] = bits;
+    }
+}
+
+
+#ifdef KERNELS_X86
+// Byte stride only. Compares the first and last byte of a whole vector of
+// positions at once, only positions that pass both are compared in full.
+#define DEFINE_STRING_KERNEL(isa, vtype, width, set1, loadu, or, and, cmpeq, movemask) \
+__attribute__((target(#isa))) \
+static void isa##_string_equal(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask) { \
+    const scan_string_t *string = needle; \
+    size_t last = string->size - 1; \
+    vtype first_fold = set1((char)string->fold[0]); \
+    vtype first_byte = set1((char)string->bytes[0]); \
+    vtype last_fold = set1((char)string->fold[last]); \
+    vtype last_byte = set1((char)string->bytes[last]); \
+    size_t word = 0; \
+    for (; (word + 1) * 64 <= count; word++) { \
+        const uint8_t *values = buffer + word * 64; \
+        uint64_t candidates = 0; \
+        for (size_t j=0; j < 64; j += width) { \
+            vtype head = or(loadu((const vtype *)(values + j)), first_fold); \
+            vtype tail = or(loadu((const vtype *)(values + j + last)), last_fold); \
+            candidates |= (uint64_t)(uint32_t)movemask(and(cmpeq(head, first_byte), cmpeq(tail, last_byte))) << j; \
+        } \
+        uint64_t bits = 0; \
+        while (candidates != 0) { \
+            size_t i = (size_t)__builtin_ctzll(candidates); \
+            if (compare_string_equal(values + i, string)) { \
+                bits |= 1ull << i; \
+            } \
+            candidates &= candidates - 1; \
+        } \
+        mask[word] = bits; \
+    } \
+    if (word * 64 < count) { \
+        mask_string_equal(buffer + word * 64, count - word * 64, stride, needle, mask + word); \
+    } \
+}
+
+DEFINE_STRING_KERNEL(sse2, __m128i, 16, _mm_set1_epi8, _mm_loadu_si128, _mm_or_si128, _mm_and_si128, _mm_cmpeq_epi8, _mm_movemask_epi8)
+DEFINE_STRING_KERNEL(avx2, __m256i, 32, _mm256_set1_epi8, _mm256_loadu_si256, _mm256_or_si256, _mm256_and_si256, _mm256_cmpeq_epi8, _mm256_movemask_epi8)
+#endif
+
+
+// Strings are only ever searched for as a whole, every other op has no
+// kernel
+static scan_kernel_t string_kernel_select(search_op_e op, size_t stride) {
+    scan_kernel_t kernel = {NULL, NULL};
+    if (op == SEARCH_NOOP) {
+        kernel = (scan_kernel_t){ mask_noop, compare_noop };
+    } else if (op == SEARCH_EQUAL) {
+        kernel = (scan_kernel_t){ mask_string_equal, compare_string_equal };
+#ifdef KERNELS_X86
+        __builtin_cpu_init();
+        if (stride == 1 && __builtin_cpu_supports("avx2")) {
+            kernel.mask = avx2_string_equal;
+        } else if (stride == 1 && __builtin_cpu_supports("sse2")) {
+            kernel.mask = sse2_string_equal;
+        }
+#endif
+    }
+    (void)stride;
+    return kernel;
+}
+
+
+// Whether every field of the group from field first on matches the
+// structure at value
+static bool group_matches(const uint8_t *value, const scan_group_t *group, size_t first) {
+    for (size_t i=first; i < group->field_count; i++) {
+        const scan_field_t *field = &group->fields[i];
+        if (!scalar_kernels[field->type][field->op].compare(value + field->offset, &field->value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool compare_group_equal(const void *value, const void *needle) {
+    return group_matches(value, needle, 0);
+}
+
+
+// Runs the best mask kernel of the first field over every base, then checks
+// the other fields only where it matched
+static void mask_group_equal(const uint8_t *buffer, size_t count, size_t stride, const void *needle, uint64_t *mask) {
+    const scan_group_t *group = needle;
+    const scan_field_t *first = &group->fields[0];
+    kernel_select(first->type, first->op, stride).mask(buffer + first->offset, count, stride, &first->value, mask);
+    for (size_t word=0; word * 64 < count; word++) {
+        uint64_t candidates = mask[word];
+        uint64_t bits = 0;
+        while (candidates != 0) {
+            size_t i = (size_t)__builtin_ctzll(candidates);
+            if (group_matches(buffer + (word * 64 + i) * stride, group, 1)) {
+                bits |= 1ull << i;
+            }
+            candidates &= candidates - 1;
+        }
+        mask[word] = bits;
+    }
+}
+
+
+static mask_kernel_t best_simd_mask(scan_type_e type, search_op_e op) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2_masks[type][op];
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return sse2_masks[type][op];
+    }
+#endif
+    (void)type;
+    (void)op;
+    return NULL;
+}
+
+
+scan_kernel_t kernel_select(scan_type_e type, search_op_e op, size_t stride) {
+    if (type == SCANTYPE_STRING) {
+        return string_kernel_select(op, stride);
+    }
+    if (type == SCANTYPE_GROUP) {
+        if (op == SEARCH_NOOP) {
+            return (scan_kernel_t){ mask_noop, compare_noop };
+        }
+        if (op == SEARCH_EQUAL) {
+            return (scan_kernel_t){ mask_group_equal, compare_group_equal };
+        }
+        return (scan_kernel_t){ NULL, NULL };
+    }
+    if (stride == 1) {
+        return byte_kernels[type][op];
+    }
+    if (stride != scan_type_size(type)) {
+        return strided_kernels[type][op];
+    }
+
+    scan_kernel_t kernel = scalar_kernels[type][op];
+    mask_kernel_t simd_mask = best_simd_mask(type, op);
+    if (simd_mask != NULL) {
+        kernel.mask = simd_mask;
+    }
+    return kernel;
+}
+
+
+range_kernel_t range_kernel_select(scan_type_e type) {
+    if (type > SCANTYPE_FLOAT64) {
+        return NULL;
+    }
+    return range_kernels[type];
+}
+
+
+bool search_op_is_relative(search_op_e op) {
+    return op == SEARCH_CHANGED || op == SEARCH_UNCHANGED || op == SEARCH_INCREASED || op == SEARCH_DECREASED;
+}
+
+
+size_t kernel_mask_words(size_t count) {
+    return (count + 63) / 64;
+}
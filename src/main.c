@@ -1,4 +1,5 @@
-#define _POSIX_C_SOURCE 199309L
+#include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,10 +7,16 @@
 #include <string.h>
 #include <signal.h>
 
+#include "pointer_map.h"
 #include "string_list.h"
 #include "subject.h"
 
 
+// How long a search may take before the prompt returns and it carries on in
+// the background
+#define ASYNC_GRACE_MS 200
+
+
 typedef enum command_type_e {
     CMD_FIND_EXACT,
     CMD_FIND_APPROXIMATE,
@@ -17,6 +24,27 @@ typedef enum command_type_e {
     CMD_SET_VALUE,
     CMD_REFRESH,
     CMD_ELIMINATE,
+    CMD_SNAPSHOT,
+    CMD_FIND_RELATIVE,
+    CMD_LIVE,
+    CMD_DIRTY,
+    CMD_REGIONS,
+    CMD_STATS,
+    CMD_FREEZE,
+    CMD_UNFREEZE,
+    CMD_LIST,
+    CMD_SAVE,
+    CMD_LOAD,
+    CMD_DIFF,
+    CMD_PROGRESS,
+    CMD_WAIT,
+    CMD_CANCEL,
+    CMD_POINTERS,
+    CMD_PATTERN,
+    CMD_STRING,
+    CMD_GROUP,
+    CMD_INDEX,
+    CMD_QUERY,
     CMD_QUIT,
 } command_type_e;
 
@@ -46,6 +74,74 @@ typedef struct command_find_bounded_t {
     double max_value;
 } command_find_bounded_t;
 
+typedef struct command_find_relative_t {
+    command_type_e type;
+    search_op_e op;
+} command_find_relative_t;
+
+typedef struct command_regions_t {
+    command_type_e type;
+    unsigned kinds;
+    char module[128];
+} command_regions_t;
+
+typedef struct command_freeze_t {
+    command_type_e type;
+    double value;
+    unsigned interval_ms;
+} command_freeze_t;
+
+typedef struct command_stats_t {
+    command_type_e type;
+    bool reset;
+} command_stats_t;
+
+typedef struct command_file_t {
+    command_type_e type;
+    char paths[2][128];
+} command_file_t;
+
+typedef struct command_pointers_t {
+    command_type_e type;
+    size_t index;
+    unsigned depth;
+    size_t max_offset;
+} command_pointers_t;
+
+typedef struct command_pattern_t {
+    command_type_e type;
+    // Patterns separated by |
+    char text[256];
+} command_pattern_t;
+
+typedef struct command_string_t {
+    command_type_e type;
+    string_encoding_e encoding;
+    bool ignore_case;
+    // Empty to narrow the current string scan
+    char text[256];
+} command_string_t;
+
+typedef struct command_group_t {
+    command_type_e type;
+    // None to narrow the current group scan
+    scan_field_t fields[SCAN_GROUP_MAX_FIELDS];
+    size_t field_count;
+} command_group_t;
+
+typedef struct command_index_t {
+    command_type_e type;
+    // Refresh the current index instead of snapshotting and indexing anew
+    bool refresh;
+} command_index_t;
+
+typedef struct command_query_t {
+    command_type_e type;
+    search_op_e ops[2];
+    double values[2];
+    size_t op_count;
+} command_query_t;
+
 typedef union command_u {
     command_type_e type;
     command_find_exact_t exact;
@@ -53,19 +149,20 @@ typedef union command_u {
     command_find_bounded_t bounded;
     command_eliminate_t eliminate;
     command_find_approximate_t approximate;
+    command_find_relative_t relative;
+    command_regions_t regions;
+    command_stats_t stats;
+    command_freeze_t freeze;
+    command_file_t file;
+    command_pointers_t pointers;
+    command_pattern_t pattern;
+    command_string_t string;
+    command_group_t group;
+    command_index_t index;
+    command_query_t query;
 } command_u;
 
 
-static void ms_sleep(long milliseconds)
-{
-    struct timespec sleep_duration = {
-        .tv_sec = milliseconds / 1000,
-        .tv_nsec = (milliseconds % 1000) * 1000000,
-    };
-    nanosleep(&sleep_duration, &sleep_duration);
-}
-
-
 static bool streq(const char *a, const char *b) {
     return strcmp(a, b) == 0;
 }
@@ -83,6 +180,82 @@ static void get_input_line(char *buffer, size_t buffer_size) {
 }
 
 
+static const char *const field_type_names[] = {
+    [SCANTYPE_UINT8] = "u8", [SCANTYPE_UINT16] = "u16", [SCANTYPE_UINT32] = "u32", [SCANTYPE_UINT64] = "u64",
+    [SCANTYPE_INT8] = "i8", [SCANTYPE_INT16] = "i16", [SCANTYPE_INT32] = "i32", [SCANTYPE_INT64] = "i64",
+    [SCANTYPE_FLOAT32] = "f32", [SCANTYPE_FLOAT64] = "f64",
+};
+
+
+// Parses <offset>:<type>:<value>, where a value prefixed by < is a most, >
+// a least and ~ an approximate value
+static bool parse_field(const char *text, scan_field_t *field) {
+    char *end;
+    field->offset = strtoul(text, &end, 0);
+    if (end == text || *end != ':') {
+        return false;
+    }
+    const char *type = end + 1;
+    const char *separator = strchr(type, ':');
+    if (separator == NULL) {
+        return false;
+    }
+    size_t type_length = (size_t)(separator - type);
+    size_t type_index = 0;
+    for (; type_index <= SCANTYPE_FLOAT64; type_index++) {
+        const char *name = field_type_names[type_index];
+        if (strlen(name) == type_length && strncmp(name, type, type_length) == 0) {
+            break;
+        }
+    }
+    if (type_index > SCANTYPE_FLOAT64) {
+        return false;
+    }
+    field->type = (scan_type_e)type_index;
+
+    const char *value = separator + 1;
+    field->op = SEARCH_EQUAL;
+    if (*value == '<') {
+        field->op = SEARCH_LESS;
+        value++;
+    } else if (*value == '>') {
+        field->op = SEARCH_GREATER;
+        value++;
+    } else if (*value == '~') {
+        field->op = SEARCH_APPROX;
+        value++;
+    }
+    // Integers are parsed as such so they keep every bit, and are rejected
+    // when they do not fit the field's type
+    memset(&field->value, 0, sizeof(field->value));
+    errno = 0;
+    bool fits = true;
+    if (field->type == SCANTYPE_FLOAT32 || field->type == SCANTYPE_FLOAT64) {
+        field->value = scan_value_from_double(field->type, strtod(value, &end));
+    } else if (field->type <= SCANTYPE_UINT64) {
+        // strtoull wraps negative numbers around
+        unsigned long long number = strtoull(value, &end, 0);
+        fits = *value != '-' && errno != ERANGE;
+        switch (field->type) {
+            case SCANTYPE_UINT8: fits = fits && number <= UINT8_MAX; field->value.uint8 = (uint8_t)number; break;
+            case SCANTYPE_UINT16: fits = fits && number <= UINT16_MAX; field->value.uint16 = (uint16_t)number; break;
+            case SCANTYPE_UINT32: fits = fits && number <= UINT32_MAX; field->value.uint32 = (uint32_t)number; break;
+            default: field->value.uint64 = number; break;
+        }
+    } else {
+        long long number = strtoll(value, &end, 0);
+        fits = errno != ERANGE;
+        switch (field->type) {
+            case SCANTYPE_INT8: fits = fits && number >= INT8_MIN && number <= INT8_MAX; field->value.int8 = (int8_t)number; break;
+            case SCANTYPE_INT16: fits = fits && number >= INT16_MIN && number <= INT16_MAX; field->value.int16 = (int16_t)number; break;
+            case SCANTYPE_INT32: fits = fits && number >= INT32_MIN && number <= INT32_MAX; field->value.int32 = (int32_t)number; break;
+            default: field->value.int64 = number; break;
+        }
+    }
+    return fits && end != value && *end == '\0';
+}
+
+
 static void get_command(command_u *command) {
     string_list_t *args = NULL;
     char line[256];
@@ -169,6 +342,34 @@ static void get_command(command_u *command) {
             break;
         }
 
+        if (streq(cmd, "freeze") || streq(cmd, "f")) {
+            if (args->length != 2 && args->length != 3) {
+                printf("usage: freeze <value> [interval ms]\n");
+                continue;
+            }
+            command->type = CMD_FREEZE;
+            command->freeze.value = strtod(args->strings[1], &end);
+            if (*end != '\0') {
+                printf("error: invalid float64 value\n");
+                continue;
+            }
+            command->freeze.interval_ms = 0;
+            if (args->length == 3) {
+                unsigned long interval = strtoul(args->strings[2], &end, 10);
+                if (*end != '\0' || interval == 0 || interval > UINT_MAX) {
+                    printf("error: invalid interval\n");
+                    continue;
+                }
+                command->freeze.interval_ms = (unsigned)interval;
+            }
+            break;
+        }
+
+        if (streq(cmd, "unfreeze")) {
+            command->type = CMD_UNFREEZE;
+            break;
+        }
+
         if (streq(cmd, "bounded") || streq(cmd, "bound") || streq(cmd, "b")) {
             if (args->length != 3) {
                 printf("usage: set <min> <max>\n");
@@ -193,6 +394,239 @@ static void get_command(command_u *command) {
             break;
         }
 
+        if (streq(cmd, "live")) {
+            command->type = CMD_LIVE;
+            break;
+        }
+
+        if (streq(cmd, "dirty")) {
+            command->type = CMD_DIRTY;
+            break;
+        }
+
+        if (streq(cmd, "regions") || streq(cmd, "reg")) {
+            command->type = CMD_REGIONS;
+            command->regions.kinds = (args->length == 1) ? REGION_ALL : 0;
+            command->regions.module[0] = '\0';
+            for (size_t i=1; i < args->length; i++) {
+                const char *kind = args->strings[i];
+                if (streq(kind, "all")) {
+                    command->regions.kinds |= REGION_ALL;
+                } else if (streq(kind, "heap")) {
+                    command->regions.kinds |= REGION_HEAP;
+                } else if (streq(kind, "stack")) {
+                    command->regions.kinds |= REGION_STACK;
+                } else if (streq(kind, "anon")) {
+                    command->regions.kinds |= REGION_ANONYMOUS;
+                } else if (streq(kind, "module")) {
+                    command->regions.kinds |= REGION_MODULE;
+                } else {
+                    // Anything else names the modules to scan
+                    command->regions.kinds |= REGION_MODULE;
+                    snprintf(command->regions.module, sizeof(command->regions.module), "%s", kind);
+                }
+            }
+            break;
+        }
+
+        if (streq(cmd, "stats")) {
+            command->type = CMD_STATS;
+            command->stats.reset = (args->length > 1 && streq(args->strings[1], "reset"));
+            break;
+        }
+
+        if (streq(cmd, "progress") || streq(cmd, "p")) {
+            command->type = CMD_PROGRESS;
+            break;
+        }
+
+        if (streq(cmd, "wait") || streq(cmd, "w")) {
+            command->type = CMD_WAIT;
+            break;
+        }
+
+        if (streq(cmd, "cancel")) {
+            command->type = CMD_CANCEL;
+            break;
+        }
+
+        if (streq(cmd, "pointers") || streq(cmd, "ptr")) {
+            if (args->length < 2 || args->length > 4) {
+                printf("usage: pointers <index> [depth] [max offset]\n");
+                continue;
+            }
+            command->type = CMD_POINTERS;
+            command->pointers.index = strtoul(args->strings[1], &end, 10);
+            if (*end != '\0') {
+                printf("error: invalid index\n");
+                continue;
+            }
+            command->pointers.depth = 0;
+            command->pointers.max_offset = 0;
+            if (args->length > 2) {
+                unsigned long depth = strtoul(args->strings[2], &end, 10);
+                if (*end != '\0' || depth == 0 || depth > POINTER_MAX_DEPTH) {
+                    printf("error: depth must be between 1 and %d\n", POINTER_MAX_DEPTH);
+                    continue;
+                }
+                command->pointers.depth = (unsigned)depth;
+            }
+            if (args->length > 3) {
+                command->pointers.max_offset = strtoul(args->strings[3], &end, 0);
+                if (*end != '\0' || command->pointers.max_offset == 0) {
+                    printf("error: invalid max offset\n");
+                    continue;
+                }
+            }
+            break;
+        }
+
+        if (streq(cmd, "aob")) {
+            if (args->length < 2) {
+                printf("usage: aob <hex bytes> [| <hex bytes> ...]\n");
+                continue;
+            }
+            command->type = CMD_PATTERN;
+            command->pattern.text[0] = '\0';
+            size_t length = 0;
+            for (size_t i=1; i < args->length && length < sizeof(command->pattern.text); i++) {
+                length += snprintf(command->pattern.text + length, sizeof(command->pattern.text) - length, "%s%s", (i > 1) ? " " : "", args->strings[i]);
+            }
+            break;
+        }
+
+        if (streq(cmd, "string") || streq(cmd, "str")) {
+            command->type = CMD_STRING;
+            command->string.encoding = STRING_UTF8;
+            command->string.ignore_case = false;
+            command->string.text[0] = '\0';
+            // Options come first, words after them are joined by one space
+            size_t first = 1;
+            for (; first + 1 < args->length; first++) {
+                if (streq(args->strings[first], "utf16")) {
+                    command->string.encoding = STRING_UTF16;
+                } else if (streq(args->strings[first], "nocase")) {
+                    command->string.ignore_case = true;
+                } else {
+                    break;
+                }
+            }
+            size_t length = 0;
+            for (size_t i=first; i < args->length && length < sizeof(command->string.text); i++) {
+                length += snprintf(command->string.text + length, sizeof(command->string.text) - length, "%s%s", (i > first) ? " " : "", args->strings[i]);
+            }
+            break;
+        }
+
+        if (streq(cmd, "group") || streq(cmd, "g")) {
+            if (args->length > SCAN_GROUP_MAX_FIELDS + 1) {
+                printf("error: a group has at most %d fields\n", SCAN_GROUP_MAX_FIELDS);
+                continue;
+            }
+            command->type = CMD_GROUP;
+            command->group.field_count = args->length - 1;
+            bool valid = true;
+            for (size_t i=1; i < args->length && valid; i++) {
+                valid = parse_field(args->strings[i], &command->group.fields[i - 1]);
+                if (!valid) {
+                    printf("error: invalid field '%s'\n", args->strings[i]);
+                }
+            }
+            if (!valid) {
+                continue;
+            }
+            break;
+        }
+
+        if (streq(cmd, "index")) {
+            command->type = CMD_INDEX;
+            command->index.refresh = (args->length > 1 && streq(args->strings[1], "refresh"));
+            break;
+        }
+
+        if (streq(cmd, "query")) {
+            if (args->length != 3) {
+                printf("usage: query =|<|>|~ <value>, query <min> <max>\n");
+                continue;
+            }
+            command->type = CMD_QUERY;
+            const char *op = args->strings[1];
+            if (streq(op, "=") || streq(op, "<") || streq(op, ">") || streq(op, "~")) {
+                command->query.ops[0] = streq(op, "=") ? SEARCH_EQUAL : streq(op, "<") ? SEARCH_LESS : streq(op, ">") ? SEARCH_GREATER : SEARCH_APPROX;
+                command->query.op_count = 1;
+            } else {
+                command->query.ops[0] = SEARCH_GREATER;
+                command->query.ops[1] = SEARCH_LESS;
+                command->query.op_count = 2;
+                command->query.values[0] = strtod(op, &end);
+                if (*end != '\0') {
+                    printf("error: invalid float64 min\n");
+                    continue;
+                }
+            }
+            command->query.values[command->query.op_count - 1] = strtod(args->strings[2], &end);
+            if (*end != '\0') {
+                printf("error: invalid float64 value\n");
+                continue;
+            }
+            break;
+        }
+
+        if (streq(cmd, "list") || streq(cmd, "l")) {
+            command->type = CMD_LIST;
+            break;
+        }
+
+        if (streq(cmd, "save") || streq(cmd, "load")) {
+            if (args->length != 2) {
+                printf("usage: %s <path>\n", cmd);
+                continue;
+            }
+            command->type = streq(cmd, "save") ? CMD_SAVE : CMD_LOAD;
+            snprintf(command->file.paths[0], sizeof(command->file.paths[0]), "%s", args->strings[1]);
+            break;
+        }
+
+        if (streq(cmd, "diff")) {
+            if (args->length != 3) {
+                printf("usage: diff <old path> <new path>\n");
+                continue;
+            }
+            command->type = CMD_DIFF;
+            snprintf(command->file.paths[0], sizeof(command->file.paths[0]), "%s", args->strings[1]);
+            snprintf(command->file.paths[1], sizeof(command->file.paths[1]), "%s", args->strings[2]);
+            break;
+        }
+
+        if (streq(cmd, "snapshot") || streq(cmd, "snap")) {
+            command->type = CMD_SNAPSHOT;
+            break;
+        }
+
+        if (streq(cmd, "changed") || streq(cmd, "c")) {
+            command->type = CMD_FIND_RELATIVE;
+            command->relative.op = SEARCH_CHANGED;
+            break;
+        }
+
+        if (streq(cmd, "unchanged") || streq(cmd, "u")) {
+            command->type = CMD_FIND_RELATIVE;
+            command->relative.op = SEARCH_UNCHANGED;
+            break;
+        }
+
+        if (streq(cmd, "increased") || streq(cmd, "+")) {
+            command->type = CMD_FIND_RELATIVE;
+            command->relative.op = SEARCH_INCREASED;
+            break;
+        }
+
+        if (streq(cmd, "decreased") || streq(cmd, "-")) {
+            command->type = CMD_FIND_RELATIVE;
+            command->relative.op = SEARCH_DECREASED;
+            break;
+        }
+
         printf("error: unrecognized command '%s'\n", cmd);
     }
 
@@ -202,9 +636,465 @@ static void get_command(command_u *command) {
 }
 
 
+static size_t active_scans(scan_t *float32_scan, scan_t *float64_scan, double number, scan_t **scans, scan_value_u *values) {
+    size_t scan_count = 0;
+    if (float32_scan) {
+        scans[scan_count] = float32_scan;
+        values[scan_count++] = scan_value_from_double(SCANTYPE_FLOAT32, number);
+    }
+    if (float64_scan) {
+        scans[scan_count] = float64_scan;
+        values[scan_count++] = scan_value_from_double(SCANTYPE_FLOAT64, number);
+    }
+    return scan_count;
+}
+
+
+// Runs the same search over every active scan, so that first passes share a
+// single read of the subject's memory
+static bool update_scans(subject_t *subject, scan_t *float32_scan, scan_t *float64_scan, search_op_e op, double number) {
+    scan_t *scans[2];
+    scan_value_u values[2];
+    size_t scan_count = active_scans(float32_scan, float64_scan, number, scans, values);
+    return subject_update_scans(subject, scans, values, scan_count, op);
+}
+
+
+// Starts update_scans in the background and gives it a moment to finish, so
+// quick searches still print their matches right away. Returns true once the
+// search is done, false if it is still running or could not start.
+static bool update_scans_async(subject_t *subject, scan_t *float32_scan, scan_t *float64_scan, search_op_e op, double number) {
+    scan_t *scans[2];
+    scan_value_u values[2];
+    size_t scan_count = active_scans(float32_scan, float64_scan, number, scans, values);
+    if (!subject_update_scans_async(subject, scans, values, scan_count, op, NULL, NULL)) {
+        printf("error: failed to start search\n");
+        return false;
+    }
+
+    scan_progress_t progress;
+    for (int i=0; i < ASYNC_GRACE_MS / 10; i++) {
+        subject_scan_progress(subject, &progress);
+        if (!progress.running) {
+            if (!subject_wait_scan(subject)) {
+                printf("error: search failed\n");
+            }
+            return true;
+        }
+        usleep(10000);
+    }
+    printf("Searching in the background, use progress, wait or cancel\n");
+    return false;
+}
+
+
+typedef struct pointer_paths {
+    size_t count;
+} pointer_paths_t;
+
+
+static bool print_pointer_path(void *context, const pointer_module_t *module, size_t module_offset, const size_t *offsets, size_t depth) {
+    pointer_paths_t *paths = context;
+    if (paths->count++ >= 32) {
+        return true;
+    }
+    const char *name = strrchr(module->filename, '/');
+    printf("%s+0x%zx", (name != NULL) ? name + 1 : module->filename, module_offset);
+    for (size_t i=0; i < depth; i++) {
+        printf(" -> 0x%zx", offsets[i]);
+    }
+    printf("\n");
+    return true;
+}
+
+
+// Builds a pointer map of the subject and lists paths from modules to the
+// hit, one pointer per level
+static void find_pointer_paths(subject_t *subject, size_t address, const command_pointers_t *command) {
+    pointer_scan_options_t options;
+    pointer_scan_options_init(&options);
+    if (command->depth != 0) {
+        options.max_depth = command->depth;
+    }
+    if (command->max_offset != 0) {
+        options.max_offset = command->max_offset;
+    }
+
+    pointer_map_t *map = pointer_map_build(subject);
+    if (map == NULL) {
+        printf("error: failed to build pointer map\n");
+        return;
+    }
+    printf("Indexed %zu pointers, searching paths to 0x%zx\n", map->count, address);
+    pointer_paths_t paths = {0};
+    if (pointer_map_find_paths(map, address, &options, print_pointer_path, &paths)) {
+        if (paths.count > 32) {
+            printf("...\n");
+        }
+        printf("%zu paths\n", paths.count);
+    }
+    pointer_map_free(map);
+}
+
+
+// Searches for every pattern of the command in one pass and lists the
+// matches of each
+static void find_patterns(subject_t *subject, const command_pattern_t *command) {
+    string_list_t *texts = string_split(command->text, "|", false);
+    if (texts == NULL) {
+        return;
+    }
+    pattern_set_t *set = pattern_set_compile((const char *const *)texts->strings, texts->length);
+    if (set == NULL) {
+        printf("error: invalid pattern\n");
+        string_list_free(texts);
+        return;
+    }
+
+    hit_set_t *hits = calloc(set->count, sizeof(hit_set_t));
+    if (hits == NULL) {
+        printf("error: out of memory\n");
+        goto EXIT;
+    }
+    for (size_t i=0; i < set->count; i++) {
+        hit_set_init(&hits[i]);
+    }
+    if (!subject_find_patterns(subject, set, hits)) {
+        printf("error: pattern search failed\n");
+        goto EXIT;
+    }
+    for (size_t i=0; i < set->count; i++) {
+        if (set->count > 1) {
+            printf("Pattern %zu:\n", i);
+        }
+        printf("Matches: %zu\n", hits[i].count);
+        for (size_t j=0; j < 32 && j < hits[i].count; j++) {
+            printf("%zu. 0x%zx\n", j, hit_set_get(&hits[i], j));
+        }
+        if (hits[i].count > 32) {
+            printf("...\n");
+        }
+    }
+
+  EXIT:
+    if (hits != NULL) {
+        for (size_t i=0; i < set->count; i++) {
+            hit_set_clear(&hits[i]);
+        }
+    }
+    free(hits);
+    pattern_set_free(set);
+    string_list_free(texts);
+}
+
+
+// Prints the printable ASCII characters of a string value, anything else as
+// a dot
+static void print_string(const scan_string_t *string, const uint8_t *bytes) {
+    size_t unit_size = (string->encoding == STRING_UTF16) ? 2 : 1;
+    printf("\"");
+    for (size_t i=0; i < string->size; i += unit_size) {
+        bool ascii = (unit_size == 1 || bytes[i + 1] == 0);
+        putchar((ascii && bytes[i] >= 0x20 && bytes[i] < 0x7f) ? bytes[i] : '.');
+    }
+    printf("\"");
+}
+
+
+static void print_string_matches(scan_t *string_scan) {
+    printf("Matches: %zu\n", string_scan->hits.count);
+    for (size_t i=0; i < 32 && i < string_scan->hits.count; i++) {
+        printf("%zu. ", i);
+        print_string(string_scan->string, value_column_get(&string_scan->values, i));
+        printf(" 0x%zx\n", hit_set_get(&string_scan->hits, i));
+    }
+    if (string_scan->hits.count > 32) {
+        printf("...\n");
+    }
+}
+
+
+// Starts a new string scan, replacing the current one, or narrows the
+// current one to the hits that still hold its string
+static void find_string(subject_t *subject, scan_t **string_scan, const command_string_t *command) {
+    if (command->text[0] != '\0') {
+        scan_t *scan = subject_begin_string_scan(subject, command->text, command->encoding, command->ignore_case);
+        if (scan == NULL) {
+            printf("error: failed to begin string scan\n");
+            return;
+        }
+        scan_free(*string_scan);
+        *string_scan = scan;
+    } else if (*string_scan == NULL) {
+        printf("usage: string [utf16] [nocase] <text>\n");
+        return;
+    }
+
+    scan_value_u unused = {0};
+    if (!subject_update_scans(subject, string_scan, &unused, 1, SEARCH_EQUAL)) {
+        printf("error: string search failed\n");
+        return;
+    }
+    print_string_matches(*string_scan);
+}
+
+
+static void print_progress(const scan_progress_t *progress) {
+    double percent = (progress->bytes_total > 0) ? 100.0 * (double)progress->bytes_done / (double)progress->bytes_total : 0;
+    printf(
+        "%.1f%% (%" PRIu64 " of %" PRIu64 " MB, %" PRIu64 " of %" PRIu64 " regions), %" PRIu64 " hits so far\n",
+        percent, progress->bytes_done >> 20, progress->bytes_total >> 20,
+        progress->regions_done, progress->region_count, progress->hits
+    );
+}
+
+
+static void print_matches(scan_t *float32_scan, scan_t *float64_scan) {
+    size_t total_hit_count = 0;
+    if (float32_scan) {
+        total_hit_count += float32_scan->hits.count;
+    }
+    if (float64_scan) {
+        total_hit_count += float64_scan->hits.count;
+    }
+    printf("Matches: %zu\n", total_hit_count);
+
+    size_t hit_index = 0;
+    if (float32_scan) {
+        for (size_t i=0; i < 32 && i < float32_scan->hits.count; i++) {
+            scan_value_u value = scan_get_value(float32_scan, i);
+            printf("%zu. %f 0x%zx (Float32)\n", hit_index+i, value.float32, hit_set_get(&float32_scan->hits, i));
+        }
+        if (float32_scan->hits.count >= 32) {
+            printf("...\n");
+        }
+        hit_index += float32_scan->hits.count;
+    }
+    if (float64_scan) {
+        for (size_t i=0; i < 32 && i < float64_scan->hits.count; i++) {
+            scan_value_u value = scan_get_value(float64_scan, i);
+            printf("%zu. %lf 0x%zx (Float64)\n", hit_index+i, value.float64, hit_set_get(&float64_scan->hits, i));
+        }
+        if (float64_scan->hits.count >= 32) {
+            printf("...\n");
+        }
+        hit_index += float64_scan->hits.count;
+    }
+}
+
+
+// Snapshots and indexes every active scan, which starts them over, or
+// brings their indexes up to date
+static void index_scans(subject_t *subject, scan_t *float32_scan, scan_t *float64_scan, bool refresh) {
+    if (!subject_stop(subject)) {
+        printf("error: failed to stop subject\n");
+        return;
+    }
+    scan_t *scans[2];
+    scan_value_u values[2];
+    size_t scan_count = active_scans(float32_scan, float64_scan, 0, scans, values);
+    bool success = refresh || subject_snapshot_scans(subject, scans, scan_count);
+    for (size_t i=0; success && i < scan_count; i++) {
+        // Refreshing a snapshot refreshes the index of every scan sharing it
+        if (refresh && i > 0 && scans[i]->snapshot == scans[0]->snapshot) {
+            continue;
+        }
+        success = refresh ? scan_refresh_index(scans[i]) : scan_build_index(scans[i]);
+    }
+    if (!success) {
+        printf("error: failed to %s index\n", refresh ? "refresh" : "build");
+    }
+    subject_resume(subject);
+}
+
+
+// Answers a search from the indexes of the active scans and prints its
+// matches, the scans themselves are left as they are
+static void query_scans(scan_t *float32_scan, scan_t *float64_scan, const command_query_t *command) {
+    scan_t *results[2] = {NULL, NULL};
+    scan_t *scans[2] = {float32_scan, float64_scan};
+    for (size_t i=0; i < 2; i++) {
+        if (scans[i] == NULL) {
+            continue;
+        }
+        scan_value_u values[2];
+        for (size_t j=0; j < command->op_count; j++) {
+            values[j] = scan_value_from_double(scans[i]->type, command->values[j]);
+        }
+        results[i] = scan_query(scans[i], command->ops, values, command->op_count);
+        if (results[i] == NULL) {
+            printf("error: query failed, build an index first\n");
+            goto EXIT;
+        }
+    }
+    print_matches(results[0], results[1]);
+
+  EXIT:
+    scan_free(results[0]);
+    scan_free(results[1]);
+}
+
+
+static void print_value(scan_type_e type, const uint8_t *bytes) {
+    scan_value_u value = {0};
+    memcpy(&value, bytes, scan_type_size(type));
+    switch (type)
+    {
+        case SCANTYPE_UINT8: printf("%" PRIu8, value.uint8); break;
+        case SCANTYPE_UINT16: printf("%" PRIu16, value.uint16); break;
+        case SCANTYPE_UINT32: printf("%" PRIu32, value.uint32); break;
+        case SCANTYPE_UINT64: printf("%" PRIu64, value.uint64); break;
+        case SCANTYPE_INT8: printf("%" PRId8, value.int8); break;
+        case SCANTYPE_INT16: printf("%" PRId16, value.int16); break;
+        case SCANTYPE_INT32: printf("%" PRId32, value.int32); break;
+        case SCANTYPE_INT64: printf("%" PRId64, value.int64); break;
+        case SCANTYPE_FLOAT32: printf("%f", value.float32); break;
+        case SCANTYPE_FLOAT64: printf("%lf", value.float64); break;
+        case SCANTYPE_STRING: break;
+        case SCANTYPE_GROUP: break;
+    }
+}
+
+
+static void print_group_matches(scan_t *group_scan) {
+    const scan_group_t *group = group_scan->group;
+    printf("Matches: %zu\n", group_scan->hits.count);
+    for (size_t i=0; i < 32 && i < group_scan->hits.count; i++) {
+        const uint8_t *value = value_column_get(&group_scan->values, i);
+        printf("%zu. 0x%zx", i, hit_set_get(&group_scan->hits, i));
+        for (size_t j=0; j < group->field_count; j++) {
+            const scan_field_t *field = &group->fields[j];
+            printf(" +0x%zx=", field->offset);
+            print_value(field->type, value + field->offset);
+        }
+        printf("\n");
+    }
+    if (group_scan->hits.count > 32) {
+        printf("...\n");
+    }
+}
+
+
+// Starts a new group scan, replacing the current one, or narrows the
+// current one to the structures whose fields all still match
+static void find_group(subject_t *subject, scan_t **group_scan, const command_group_t *command) {
+    if (command->field_count > 0) {
+        scan_t *scan = subject_begin_group_scan(subject, command->fields, command->field_count, SCAN_ALIGN_NATURAL);
+        if (scan == NULL) {
+            printf("error: failed to begin group scan\n");
+            return;
+        }
+        scan_free(*group_scan);
+        *group_scan = scan;
+    } else if (*group_scan == NULL) {
+        printf("usage: group <offset>:<type>:[<|>|~]<value> ...\n");
+        return;
+    }
+
+    scan_value_u unused = {0};
+    if (!subject_update_scans(subject, group_scan, &unused, 1, SEARCH_EQUAL)) {
+        printf("error: group search failed\n");
+        return;
+    }
+    print_group_matches(*group_scan);
+}
+
+
+static bool list_records(void *context, const scan_file_record_t *records, size_t count) {
+    scan_t *scan = context;
+    for (size_t i=0; i < count; i++) {
+        printf("0x%" PRIx64 " ", records[i].address);
+        print_value(scan->type, records[i].value);
+        printf("\n");
+    }
+    return true;
+}
+
+
+// Path a scan is saved to, suffixed by type when both scans are active
+static void scan_path(char *buffer, size_t size, const char *path, const char *suffix, bool both) {
+    if (both) {
+        snprintf(buffer, size, "%s.%s", path, suffix);
+    } else {
+        snprintf(buffer, size, "%s", path);
+    }
+}
+
+
+static void print_diff_line(char kind, const scan_file_t *file, const scan_file_record_t *record, const scan_file_record_t *other) {
+    scan_type_e type = (scan_type_e)file->header->type;
+    printf("%c 0x%" PRIx64 " ", kind, record->address);
+    if (other != NULL) {
+        print_value(type, other->value);
+        printf(" -> ");
+    }
+    print_value(type, record->value);
+    const char *name = scan_file_region_name(file, scan_file_region(file, record->address));
+    printf("%s%s\n", (name[0] != '\0') ? " " : "", name);
+}
+
+
+// Merges two exported scans by address and lists hits that were added,
+// removed or changed value, without touching the subject
+static bool diff_scan_files(const char *old_path, const char *new_path) {
+    bool success = false;
+    scan_file_t *old_file = scan_file_open(old_path);
+    scan_file_t *new_file = scan_file_open(new_path);
+    if (old_file == NULL || new_file == NULL) {
+        goto EXIT;
+    }
+    if (old_file->header->type != new_file->header->type) {
+        printf("error: scan files hold different types\n");
+        goto EXIT;
+    }
+
+    size_t value_size = scan_type_size((scan_type_e)old_file->header->type);
+    uint64_t old_count = old_file->header->record_count;
+    uint64_t new_count = new_file->header->record_count;
+    size_t added = 0, removed = 0, changed = 0, printed = 0;
+    uint64_t i = 0, j = 0;
+    while (i < old_count || j < new_count) {
+        const scan_file_record_t *old_record = (i < old_count) ? &old_file->records[i] : NULL;
+        const scan_file_record_t *new_record = (j < new_count) ? &new_file->records[j] : NULL;
+        if (new_record == NULL || (old_record != NULL && old_record->address < new_record->address)) {
+            if (printed++ < 32) {
+                print_diff_line('-', old_file, old_record, NULL);
+            }
+            removed++;
+            i++;
+        } else if (old_record == NULL || new_record->address < old_record->address) {
+            if (printed++ < 32) {
+                print_diff_line('+', new_file, new_record, NULL);
+            }
+            added++;
+            j++;
+        } else {
+            if (memcmp(old_record->value, new_record->value, value_size) != 0) {
+                if (printed++ < 32) {
+                    print_diff_line('~', new_file, new_record, old_record);
+                }
+                changed++;
+            }
+            i++;
+            j++;
+        }
+    }
+    if (printed > 32) {
+        printf("...\n");
+    }
+    printf("%zu added, %zu removed, %zu changed\n", added, removed, changed);
+    success = true;
+
+  EXIT:
+    scan_file_close(old_file);
+    scan_file_close(new_file);
+    return success;
+}
+
+
 int main(int argc, char **argv) {
-    if (argc != 2 && argc != 3) {
-        fprintf(stderr, "usage: %s <pid> [all|float|f32|f64]\n", argv[0]);
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "usage: %s <pid> [all|float|f32|f64] [natural|byte|<alignment>]\n", argv[0]);
         return 1;
     }
 
@@ -233,23 +1123,41 @@ int main(int argc, char **argv) {
         mode = argv[2];
     }
 
+    size_t alignment = SCAN_ALIGN_NATURAL;
+    if (argc == 4) {
+        if (streq(argv[3], "natural")) {
+            alignment = SCAN_ALIGN_NATURAL;
+        } else if (streq(argv[3], "byte")) {
+            alignment = SCAN_ALIGN_BYTE;
+        } else {
+            unsigned long alignment_arg = strtoul(argv[3], &end, 10);
+            if (*end != '\0' || alignment_arg == 0 || alignment_arg > 4096) {
+                fprintf(stderr, "error: invalid alignment '%s'\n", argv[3]);
+                return 1;
+            }
+            alignment = (size_t)alignment_arg;
+        }
+    }
+
     scan_t *float32_scan = NULL;
     scan_t *float64_scan = NULL;
+    scan_t *string_scan = NULL;
+    scan_t *group_scan = NULL;
     size_t scan_count = 0;
 
     if (streq(mode, "all") || streq(mode, "float") || streq(mode, "f32")) {
-        float32_scan = subject_begin_scan(subject, SCANTYPE_FLOAT32);
+        float32_scan = subject_begin_scan(subject, SCANTYPE_FLOAT32, alignment);
         scan_count++;
     }
 
     if (streq(mode, "all") || streq(mode, "float") || streq(mode, "f64")) {
-        float64_scan = subject_begin_scan(subject, SCANTYPE_FLOAT64);
+        float64_scan = subject_begin_scan(subject, SCANTYPE_FLOAT64, alignment);
         scan_count++;
     }
 
     if (scan_count == 0) {
         fprintf(stderr, "error: invalid mode '%s'\n", mode);
-        fprintf(stderr, "usage: %s <pid> [all|float|f32|f64]\n", argv[0]);
+        fprintf(stderr, "usage: %s <pid> [all|float|f32|f64] [natural|byte|<alignment>]\n", argv[0]);
     }
 
     if (scan_count == 1) {
@@ -262,97 +1170,279 @@ int main(int argc, char **argv) {
         command_u command;
         get_command(&command);
 
+        // A background search has to be collected before anything else can
+        // touch the subject
+        scan_progress_t progress;
+        bool async_command = (command.type == CMD_PROGRESS || command.type == CMD_WAIT || command.type == CMD_CANCEL);
+        if (subject_scan_progress(subject, &progress)) {
+            if (command.type == CMD_PROGRESS && progress.running) {
+                print_progress(&progress);
+                continue;
+            }
+            if (command.type == CMD_CANCEL || command.type == CMD_QUIT) {
+                subject_cancel_scan(subject);
+            } else if (progress.running && command.type != CMD_WAIT) {
+                printf("error: a search is running, use progress, wait or cancel\n");
+                continue;
+            }
+            if (!subject_wait_scan(subject)) {
+                printf((command.type == CMD_CANCEL || progress.cancelled) ? "Search cancelled\n" : "error: search failed\n");
+            }
+            if (command.type != CMD_QUIT) {
+                print_matches(float32_scan, float64_scan);
+            }
+            if (async_command) {
+                continue;
+            }
+        } else if (async_command) {
+            printf("No search running\n");
+            continue;
+        }
+
         if (command.type == CMD_QUIT) {
             break;
         }
 
         else if (command.type == CMD_FIND_BOUNDED) {
-            if (float32_scan) {
-                ms_sleep(100);
-                if (!scan_update(float32_scan, SEARCH_GREATER, (float)command.bounded.min_value)) {
-                    printf("error: failed to float32 SEARCH_GREATER\n");
-                    break;
-                }
-                ms_sleep(100);
-                if (!scan_update(float32_scan, SEARCH_LESS, (float)command.bounded.max_value)) {
-                    printf("error: failed to float32 SEARCH_LESS\n");
-                    break;
-                }
+            if (!subject_stop(subject)) {
+                printf("error: failed to stop subject\n");
+                continue;
             }
-            if (float64_scan) {
-                ms_sleep(100);
-                if (!scan_update(float64_scan, SEARCH_GREATER, command.bounded.min_value)) {
-                    printf("error: failed to float64 SEARCH_GREATER\n");
-                    break;
-                }
-                ms_sleep(100);
-                if (!scan_update(float64_scan, SEARCH_LESS, command.bounded.max_value)) {
-                    printf("error: failed to float64 SEARCH_LESS\n");
-                    break;
-                }
+            if (!update_scans(subject, float32_scan, float64_scan, SEARCH_GREATER, command.bounded.min_value)) {
+                printf("error: failed to SEARCH_GREATER\n");
+                break;
             }
+            if (!update_scans(subject, float32_scan, float64_scan, SEARCH_LESS, command.bounded.max_value)) {
+                printf("error: failed to SEARCH_LESS\n");
+                break;
+            }
+            subject_resume(subject);
         }
 
         else if (command.type == CMD_FIND_EXACT) {
-            if (float32_scan) {
-                ms_sleep(100);
-                if (!scan_update(float32_scan, SEARCH_EQUAL, (float)command.exact.value)) {
-                    printf("error: failed to float32 SEARCH_EQUAL\n");
-                    break;
-                }
-            }
-            if (float64_scan) {
-                ms_sleep(100);
-                if (!scan_update(float64_scan, SEARCH_EQUAL, command.exact.value)) {
-                    printf("error: failed to float64 SEARCH_EQUAL\n");
-                    break;
-                }
+            if (!update_scans_async(subject, float32_scan, float64_scan, SEARCH_EQUAL, command.exact.value)) {
+                continue;
             }
         }
 
         else if (command.type == CMD_FIND_APPROXIMATE) {
-            if (float32_scan) {
-                ms_sleep(100);
-                if (!scan_update(float32_scan, SEARCH_APPROX, (float)command.exact.value)) {
-                    printf("error: failed to float32 SEARCH_EQUAL\n");
-                    break;
-                }
-            }
-            if (float64_scan) {
-                ms_sleep(100);
-                if (!scan_update(float64_scan, SEARCH_APPROX, command.exact.value)) {
-                    printf("error: failed to float64 SEARCH_EQUAL\n");
-                    break;
-                }
+            if (!update_scans_async(subject, float32_scan, float64_scan, SEARCH_APPROX, command.exact.value)) {
+                continue;
             }
         }
 
         else if (command.type == CMD_SET_VALUE) {
+            if (!subject_stop(subject)) {
+                printf("error: failed to stop subject\n");
+                continue;
+            }
             if (float32_scan) {
-                ms_sleep(100);
                 if (!scan_set_value(float32_scan, (float)command.set.value)) {
                     printf("error: failed to float32 SET_VALUE\n");
                     break;
                 }
             }
             if (float64_scan) {
-                ms_sleep(100);
                 if (!scan_set_value(float64_scan, command.set.value)) {
                     printf("error: failed to float64 SET_VALUE\n");
                     break;
                 }
             }
+            subject_resume(subject);
         }
 
         else if (command.type == CMD_REFRESH) {
+            if (!subject_stop(subject)) {
+                printf("error: failed to stop subject\n");
+                continue;
+            }
             if (float32_scan) {
-                ms_sleep(100);
                 scan_refresh(float32_scan);
             }
             if (float64_scan) {
-                ms_sleep(100);
                 scan_refresh(float64_scan);
             }
+            subject_resume(subject);
+        }
+
+        else if (command.type == CMD_SNAPSHOT) {
+            // One snapshot is shared by both scans
+            scan_t *scans[2];
+            scan_value_u values[2];
+            size_t scan_count = active_scans(float32_scan, float64_scan, 0, scans, values);
+            if (!subject_snapshot_scans(subject, scans, scan_count)) {
+                printf("error: failed to SNAPSHOT\n");
+                break;
+            }
+        }
+
+        else if (command.type == CMD_FIND_RELATIVE) {
+            if (!update_scans(subject, float32_scan, float64_scan, command.relative.op, 0)) {
+                printf("error: failed to relative search\n");
+                continue;
+            }
+        }
+
+        else if (command.type == CMD_LIVE) {
+            if (subject_set_live(subject, !subject->live)) {
+                printf("Live mode %s\n", subject->live ? "on" : "off");
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_DIRTY) {
+            if (subject_set_dirty_tracking(subject, !subject->dirty_tracking)) {
+                printf("Dirty page tracking %s\n", subject->dirty_tracking ? "on" : "off");
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_REGIONS) {
+            region_policy_t policy;
+            region_policy_init(&policy);
+            policy.kinds = command.regions.kinds;
+            if (command.regions.module[0] != '\0') {
+                policy.module = command.regions.module;
+            }
+            if (!subject_set_region_policy(subject, &policy)) {
+                printf("error: failed to set region policy\n");
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_FREEZE) {
+            if (command.freeze.interval_ms != 0) {
+                subject_set_freeze_interval(subject, command.freeze.interval_ms);
+            }
+            if (float32_scan && !scan_freeze(float32_scan, (float)command.freeze.value)) {
+                printf("error: failed to float32 FREEZE\n");
+            }
+            if (float64_scan && !scan_freeze(float64_scan, command.freeze.value)) {
+                printf("error: failed to float64 FREEZE\n");
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_UNFREEZE) {
+            if (float32_scan) {
+                scan_unfreeze(float32_scan);
+            }
+            if (float64_scan) {
+                scan_unfreeze(float64_scan);
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_LIST) {
+            if (float32_scan && !scan_stream(float32_scan, list_records, float32_scan)) {
+                printf("error: failed to float32 LIST\n");
+            }
+            if (float64_scan && !scan_stream(float64_scan, list_records, float64_scan)) {
+                printf("error: failed to float64 LIST\n");
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_SAVE) {
+            char path[160];
+            bool both = (float32_scan && float64_scan);
+            if (float32_scan) {
+                scan_path(path, sizeof(path), command.file.paths[0], "f32", both);
+                if (scan_export(float32_scan, path)) {
+                    printf("Saved %zu hits to %s\n", float32_scan->hits.count, path);
+                } else {
+                    printf("error: failed to float32 SAVE\n");
+                }
+            }
+            if (float64_scan) {
+                scan_path(path, sizeof(path), command.file.paths[0], "f64", both);
+                if (scan_export(float64_scan, path)) {
+                    printf("Saved %zu hits to %s\n", float64_scan->hits.count, path);
+                } else {
+                    printf("error: failed to float64 SAVE\n");
+                }
+            }
+            continue;
+        }
+
+        else if (command.type == CMD_LOAD) {
+            scan_t *scan = subject_import_scan(subject, command.file.paths[0]);
+            if (scan == NULL) {
+                printf("error: failed to LOAD\n");
+                continue;
+            }
+            // Replaces the active scan of the same type
+            if (scan->type == SCANTYPE_FLOAT32) {
+                scan_free(float32_scan);
+                float32_scan = scan;
+            } else if (scan->type == SCANTYPE_FLOAT64) {
+                scan_free(float64_scan);
+                float64_scan = scan;
+            } else {
+                printf("error: only float scans can be loaded\n");
+                scan_free(scan);
+                continue;
+            }
+        }
+
+        else if (command.type == CMD_POINTERS) {
+            size_t index = command.pointers.index;
+            if (float32_scan && index < float32_scan->hits.count) {
+                find_pointer_paths(subject, hit_set_get(&float32_scan->hits, index), &command.pointers);
+                continue;
+            }
+            index -= float32_scan ? float32_scan->hits.count : 0;
+            if (float64_scan && index < float64_scan->hits.count) {
+                find_pointer_paths(subject, hit_set_get(&float64_scan->hits, index), &command.pointers);
+                continue;
+            }
+            printf("error: invalid index number\n");
+            continue;
+        }
+
+        else if (command.type == CMD_PATTERN) {
+            find_patterns(subject, &command.pattern);
+            continue;
+        }
+
+        else if (command.type == CMD_STRING) {
+            find_string(subject, &string_scan, &command.string);
+            continue;
+        }
+
+        else if (command.type == CMD_INDEX) {
+            index_scans(subject, float32_scan, float64_scan, command.index.refresh);
+            continue;
+        }
+
+        else if (command.type == CMD_QUERY) {
+            query_scans(float32_scan, float64_scan, &command.query);
+            continue;
+        }
+
+        else if (command.type == CMD_GROUP) {
+            find_group(subject, &group_scan, &command.group);
+            continue;
+        }
+
+        else if (command.type == CMD_DIFF) {
+            diff_scan_files(command.file.paths[0], command.file.paths[1]);
+            continue;
+        }
+
+        else if (command.type == CMD_STATS) {
+            if (command.stats.reset) {
+                subject_reset_stats(subject);
+                continue;
+            }
+            print_stats("Subject", &subject->stats);
+            if (float32_scan) {
+                print_stats("Float32 scan", &float32_scan->stats);
+            }
+            if (float64_scan) {
+                print_stats("Float64 scan", &float64_scan->stats);
+            }
+            continue;
         }
 
         else if (command.type == CMD_ELIMINATE) {
@@ -360,19 +1450,19 @@ int main(int argc, char **argv) {
             scan_t *target_scan = NULL;
             size_t target_index = command.eliminate.value;
             if (float32_scan && !eliminate_match) {
-                if (target_index < float32_scan->hit_count) {
+                if (target_index < float32_scan->hits.count) {
                     scan_eliminate(float32_scan, target_index);
                     eliminate_match = true;
                 } else {
-                    target_index -= float32_scan->hit_count;
+                    target_index -= float32_scan->hits.count;
                 }
             }
             if (float64_scan && !eliminate_match) {
-                if (target_index < float64_scan->hit_count) {
+                if (target_index < float64_scan->hits.count) {
                     scan_eliminate(float64_scan, target_index);
                     eliminate_match = true;
                 } else {
-                    target_index -= float64_scan->hit_count;
+                    target_index -= float64_scan->hits.count;
                 }
             }
             if (!eliminate_match) {
@@ -381,36 +1471,7 @@ int main(int argc, char **argv) {
             }
         }
 
-        size_t total_hit_count = 0;
-        if (float32_scan) {
-            total_hit_count += float32_scan->hit_count;
-        }
-        if (float64_scan) {
-            total_hit_count += float64_scan->hit_count;
-        }
-        printf("Matches: %zu\n", total_hit_count);
-
-        size_t hit_index = 0;
-        if (float32_scan) {
-            for (size_t i=0; i < 32 && i < float32_scan->hit_count; i++) {
-                scan_value_u value = float32_scan->values[i];
-                printf("%zu. %f 0x%zx (Float32)\n", hit_index+i, value.float32, float32_scan->hits[i]);
-            }
-            if (float32_scan->hit_count >= 32) {
-                printf("...\n");
-            }
-            hit_index += float32_scan->hit_count;
-        }
-        if (float64_scan) {
-            for (size_t i=0; i < 32 && i < float64_scan->hit_count; i++) {
-                scan_value_u value = float64_scan->values[i];
-                printf("%zu. %lf 0x%zx (Float64)\n", hit_index+i, value.float64, float64_scan->hits[i]);
-            }
-            if (float64_scan->hit_count >= 32) {
-                printf("...\n");
-            }
-            hit_index += float64_scan->hit_count;
-        }
+        print_matches(float32_scan, float64_scan);
     }
 
     subject_free(subject);
@@ -0,0 +1,302 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+
+#include "maps.h"
+
+
+static int open_maps(pid_t pid) {
+    char maps_path[32] = {0};
+    snprintf(maps_path, 31, "/proc/%d/maps", pid);
+    return open(maps_path, O_RDONLY);
+}
+
+
+// Reads the whole file with as few read calls as possible, /proc files
+// cannot be mapped. The result is NUL terminated.
+static char *read_file(int fd, size_t *length) {
+    size_t capacity = 65536;
+    char *text = malloc(capacity);
+    if (text == NULL) {
+        fprintf(stderr, "error: out of memory while reading /proc/<pid>/maps\n");
+        return NULL;
+    }
+
+    *length = 0;
+    while (true) {
+        if (capacity - *length < 4096) {
+            capacity *= 2;
+            char *resized_text = realloc(text, capacity);
+            if (resized_text == NULL) {
+                fprintf(stderr, "error: out of memory while reading /proc/<pid>/maps\n");
+                free(text);
+                return NULL;
+            }
+            text = resized_text;
+        }
+        ssize_t read_result = read(fd, text + *length, capacity - *length - 1);
+        if (read_result < 0) {
+            fprintf(stderr, "error: failed to read /proc/<pid>/maps: %s\n", strerror(errno));
+            free(text);
+            return NULL;
+        }
+        if (read_result == 0) {
+            break;
+        }
+        *length += (size_t)read_result;
+    }
+    text[*length] = '\0';
+    return text;
+}
+
+
+static bool parse_hex(char **cursor, size_t *value) {
+    char *c = *cursor;
+    size_t result = 0;
+    while (true) {
+        unsigned digit;
+        if (*c >= '0' && *c <= '9') {
+            digit = (unsigned)(*c - '0');
+        } else if (*c >= 'a' && *c <= 'f') {
+            digit = (unsigned)(*c - 'a' + 10);
+        } else if (*c >= 'A' && *c <= 'F') {
+            digit = (unsigned)(*c - 'A' + 10);
+        } else {
+            break;
+        }
+        result = (result << 4) | digit;
+        c++;
+    }
+    if (c == *cursor) {
+        return false;
+    }
+    *value = result;
+    *cursor = c;
+    return true;
+}
+
+
+static bool parse_decimal(char **cursor, size_t *value) {
+    char *c = *cursor;
+    size_t result = 0;
+    while (*c >= '0' && *c <= '9') {
+        result = result * 10 + (size_t)(*c - '0');
+        c++;
+    }
+    if (c == *cursor) {
+        return false;
+    }
+    *value = result;
+    *cursor = c;
+    return true;
+}
+
+
+static bool expect(char **cursor, char c) {
+    if (**cursor != c) {
+        return false;
+    }
+    (*cursor)++;
+    return true;
+}
+
+
+// Parses one "start-end perms offset major:minor inode path" line in place,
+// NUL terminating the path. Returns false for malformed lines.
+static bool parse_line(char *line, region_t *region) {
+    char *cursor = line;
+    size_t start, end, dev_major, dev_minor, inode;
+
+    if (!parse_hex(&cursor, &start) || !expect(&cursor, '-') || !parse_hex(&cursor, &end) || !expect(&cursor, ' ')) {
+        return false;
+    }
+    for (size_t i=0; i < 4; i++) {
+        if (cursor[i] == '\0') {
+            return false;
+        }
+    }
+    region->offset = start;
+    region->size = end - start;
+    region->read = (cursor[0] == 'r');
+    region->write = (cursor[1] == 'w');
+    region->exec = (cursor[2] == 'x');
+    region->shared = (cursor[3] == 's');
+    cursor += 4;
+
+    if (!expect(&cursor, ' ') || !parse_hex(&cursor, &region->file_offset) || !expect(&cursor, ' ')) {
+        return false;
+    }
+    if (!parse_hex(&cursor, &dev_major) || !expect(&cursor, ':') || !parse_hex(&cursor, &dev_minor) || !expect(&cursor, ' ')) {
+        return false;
+    }
+    if (!parse_decimal(&cursor, &inode)) {
+        return false;
+    }
+    region->inode = inode;
+
+    while (*cursor == ' ') {
+        cursor++;
+    }
+    region->filename = cursor;
+    return true;
+}
+
+
+maps_t *read_maps(pid_t pid) {
+    int fd = open_maps(pid);
+    if (fd == -1) {
+        fprintf(stderr, "error: failed to open /proc/<pid>/maps: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    size_t length;
+    char *text = read_file(fd, &length);
+    close(fd);
+    if (text == NULL) {
+        return NULL;
+    }
+
+    size_t line_count = 0;
+    for (char *c = text; (c = memchr(c, '\n', length - (size_t)(c - text))) != NULL; c++) {
+        line_count++;
+    }
+
+    maps_t *maps = calloc(1, sizeof(maps_t));
+    if (maps == NULL) {
+        fprintf(stderr, "error: out of memory while allocating maps\n");
+        free(text);
+        return NULL;
+    }
+    maps->text = text;
+    maps->regions = malloc((line_count + 1) * sizeof(region_t));
+    if (maps->regions == NULL) {
+        fprintf(stderr, "error: out of memory while allocating %zu regions\n", line_count + 1);
+        free_maps(maps);
+        return NULL;
+    }
+
+    char *line = text;
+    while (*line != '\0') {
+        char *line_end = strchr(line, '\n');
+        char *next_line;
+        if (line_end == NULL) {
+            next_line = line + strlen(line);
+        } else {
+            *line_end = '\0';
+            next_line = line_end + 1;
+        }
+        if (parse_line(line, &maps->regions[maps->region_count])) {
+            maps->region_count++;
+        }
+        line = next_line;
+    }
+
+    return maps;
+}
+
+
+void print_maps(maps_t *maps) {
+    printf("Offset           Size     RWX Name\n");
+    for (size_t i=0; i < maps->region_count; i++) {
+        region_t *region = maps->regions + i;
+        printf("%016zx %08zx %c%c%c %s\n", region->offset, region->size, (region->read?'r':'-'), (region->write?'w':'-'), (region->exec?'x':'-'), region->filename);
+    }
+}
+
+
+void free_maps(maps_t *maps) {
+    if (maps == NULL) {
+        return;
+    }
+    free(maps->regions);
+    free(maps->text);
+    free(maps);
+}
+
+
+// Matches what a scan read before policies existed: every rw region
+void region_policy_init(region_policy_t *policy) {
+    memset(policy, 0, sizeof(region_policy_t));
+    policy->kinds = REGION_ALL;
+    policy->writable = true;
+    policy->heap_first = true;
+}
+
+
+region_kind_e region_kind(const region_t *region) {
+    const char *filename = region->filename;
+    if (filename[0] == '\0' || strncmp(filename, "[anon:", 6) == 0) {
+        return REGION_ANONYMOUS;
+    }
+    if (strcmp(filename, "[heap]") == 0) {
+        return REGION_HEAP;
+    }
+    if (strncmp(filename, "[stack", 6) == 0) {
+        return REGION_STACK;
+    }
+    if (filename[0] == '[') {
+        return REGION_SPECIAL;
+    }
+    return REGION_MODULE;
+}
+
+
+static bool module_match(const char *pattern, const char *filename) {
+    if (fnmatch(pattern, filename, 0) == 0) {
+        return true;
+    }
+    const char *basename = strrchr(filename, '/');
+    return basename != NULL && fnmatch(pattern, basename + 1, 0) == 0;
+}
+
+
+// Returns whether the policy reads the region, and if so the part of it
+// that lies within the policy's address range
+bool region_policy_apply(const region_policy_t *policy, const region_t *region, size_t *offset, size_t *size) {
+    if (!region->read || (policy->writable && !region->write)) {
+        return false;
+    }
+
+    region_kind_e kind = region_kind(region);
+    if (!(policy->kinds & kind)) {
+        return false;
+    }
+    if (kind == REGION_MODULE && policy->module != NULL && !module_match(policy->module, region->filename)) {
+        return false;
+    }
+
+    if (region->size < policy->min_size || (policy->max_size != 0 && region->size > policy->max_size)) {
+        return false;
+    }
+
+    size_t start = MAX(region->offset, policy->min_address);
+    size_t end = region->offset + region->size;
+    if (policy->max_address != 0) {
+        end = MIN(end, policy->max_address);
+    }
+    if (start >= end) {
+        return false;
+    }
+
+    *offset = start;
+    *size = end - start;
+    return true;
+}
+
+
+bool region_policy_prioritized(const region_policy_t *policy, const region_t *region) {
+    return policy->heap_first && region_kind(region) == REGION_HEAP;
+}
+
+
+// Pages of private anonymous memory that were never touched read as zero.
+// Shared memory pages may live in the page cache without being mapped.
+bool region_zero_filled(const region_t *region) {
+    region_kind_e kind = region_kind(region);
+    return !region->shared && (kind == REGION_HEAP || kind == REGION_STACK || kind == REGION_ANONYMOUS);
+}
@@ -0,0 +1,380 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PATTERN_X86 1
+#endif
+
+#include "pattern.h"
+
+
+// Most first bytes the vector skips compare against, sets with more of them
+// use the lookup table
+#define PATTERN_SIMD_BYTES 8
+
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+
+// Parses hex bytes such as "48 8B ?? ?? 89". A ? stands for any nibble and a
+// lone ? for any byte, spaces between bytes are optional. The anchor is the
+// first PATTERN_ANCHOR_MAX bytes of the longest run without wildcards.
+static bool pattern_parse(pattern_t *pattern, const char *text) {
+    uint8_t bytes[PATTERN_MAX_SIZE];
+    uint8_t mask[PATTERN_MAX_SIZE];
+    size_t size = 0;
+
+    const char *cursor = text;
+    while (*cursor != '\0') {
+        if (isspace((unsigned char)*cursor)) {
+            cursor++;
+            continue;
+        }
+        if (size == PATTERN_MAX_SIZE) {
+            fprintf(stderr, "error: pattern '%s' is longer than %d bytes\n", text, PATTERN_MAX_SIZE);
+            return false;
+        }
+        if (cursor[0] == '?' && (cursor[1] == '\0' || isspace((unsigned char)cursor[1]))) {
+            bytes[size] = 0;
+            mask[size++] = 0;
+            cursor++;
+            continue;
+        }
+        if (cursor[1] == '\0' || isspace((unsigned char)cursor[1])) {
+            fprintf(stderr, "error: odd number of digits in pattern '%s'\n", text);
+            return false;
+        }
+
+        uint8_t byte = 0;
+        uint8_t byte_mask = 0;
+        for (int i=0; i < 2; i++) {
+            byte <<= 4;
+            byte_mask <<= 4;
+            if (cursor[i] == '?') {
+                continue;
+            }
+            int digit = hex_digit(cursor[i]);
+            if (digit == -1) {
+                fprintf(stderr, "error: invalid character '%c' in pattern '%s'\n", cursor[i], text);
+                return false;
+            }
+            byte |= (uint8_t)digit;
+            byte_mask |= 0xf;
+        }
+        bytes[size] = byte;
+        mask[size++] = byte_mask;
+        cursor += 2;
+    }
+
+    size_t anchor_offset = 0;
+    size_t anchor_size = 0;
+    for (size_t i=0; i < size;) {
+        size_t run = 0;
+        while (i + run < size && mask[i + run] == 0xff) {
+            run++;
+        }
+        if (run > anchor_size) {
+            anchor_offset = i;
+            anchor_size = run;
+        }
+        i += MAX(run, 1);
+    }
+    if (anchor_size == 0) {
+        fprintf(stderr, "error: pattern '%s' needs at least one byte without wildcards\n", text);
+        return false;
+    }
+
+    pattern->bytes = malloc(size);
+    pattern->mask = malloc(size);
+    if (pattern->bytes == NULL || pattern->mask == NULL) {
+        fprintf(stderr, "error: out of memory while allocating pattern\n");
+        return false;
+    }
+    memcpy(pattern->bytes, bytes, size);
+    memcpy(pattern->mask, mask, size);
+    pattern->size = size;
+    pattern->anchor_offset = anchor_offset;
+    pattern->anchor_size = MIN(anchor_size, PATTERN_ANCHOR_MAX);
+    pattern->next = -1;
+    return true;
+}
+
+
+static size_t skip_table(const pattern_set_t *set, const uint8_t *buffer, size_t size, size_t position) {
+    while (position < size && !set->first[buffer[position]]) {
+        position++;
+    }
+    return position;
+}
+
+
+static size_t skip_memchr(const pattern_set_t *set, const uint8_t *buffer, size_t size, size_t position) {
+    const uint8_t *match = memchr(buffer + position, set->first_bytes[0], size - position);
+    return (match != NULL) ? (size_t)(match - buffer) : size;
+}
+
+
+#ifdef PATTERN_X86
+// Compares a vector of memory against every first byte at once and stops at
+// the lowest position that equals any of them
+#define DEFINE_SIMD_SKIP(isa, vtype, width, set1, loadu, cmpeq, or, movemask) \
+__attribute__((target(#isa))) \
+static size_t skip_##isa(const pattern_set_t *set, const uint8_t *buffer, size_t size, size_t position) { \
+    vtype needles[PATTERN_SIMD_BYTES]; \
+    size_t count = set->first_byte_count; \
+    for (size_t i=0; i < count; i++) { \
+        needles[i] = set1((char)set->first_bytes[i]); \
+    } \
+    for (; position + width <= size; position += width) { \
+        vtype v = loadu((const vtype *)(buffer + position)); \
+        vtype found = cmpeq(v, needles[0]); \
+        for (size_t i=1; i < count; i++) { \
+            found = or(found, cmpeq(v, needles[i])); \
+        } \
+        uint32_t bits = (uint32_t)movemask(found); \
+        if (bits != 0) { \
+            return position + (size_t)__builtin_ctz(bits); \
+        } \
+    } \
+    return skip_table(set, buffer, size, position); \
+}
+
+DEFINE_SIMD_SKIP(sse2, __m128i, 16, _mm_set1_epi8, _mm_loadu_si128, _mm_cmpeq_epi8, _mm_or_si128, _mm_movemask_epi8)
+DEFINE_SIMD_SKIP(avx2, __m256i, 32, _mm256_set1_epi8, _mm256_loadu_si256, _mm256_cmpeq_epi8, _mm256_or_si256, _mm256_movemask_epi8)
+#endif
+
+
+static void select_skip(pattern_set_t *set) {
+    set->skip = skip_table;
+    if (set->first_byte_count == 1) {
+        // glibc's memchr is already vectorized
+        set->skip = skip_memchr;
+        return;
+    }
+#ifdef PATTERN_X86
+    if (set->first_byte_count <= PATTERN_SIMD_BYTES) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            set->skip = skip_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            set->skip = skip_sse2;
+        }
+    }
+#endif
+}
+
+
+// Builds the trie of anchors, then turns it into a complete automaton
+// breadth first, filling every missing transition from the state's failure
+// link
+static bool build_automaton(pattern_set_t *set) {
+    size_t max_states = 1;
+    for (size_t i=0; i < set->count; i++) {
+        max_states += set->patterns[i].anchor_size;
+    }
+    set->transitions = malloc(max_states * 256 * sizeof(int32_t));
+    set->states = malloc(max_states * sizeof(pattern_state_t));
+    int32_t *failures = malloc(max_states * sizeof(int32_t));
+    int32_t *queue = malloc(max_states * sizeof(int32_t));
+    if (set->transitions == NULL || set->states == NULL || failures == NULL || queue == NULL) {
+        fprintf(stderr, "error: out of memory while building pattern automaton\n");
+        free(failures);
+        free(queue);
+        return false;
+    }
+
+    int32_t *transitions = set->transitions;
+    memset(transitions, 0xff, 256 * sizeof(int32_t));
+    set->states[0] = (pattern_state_t){.patterns = -1, .output = -1};
+    set->state_count = 1;
+    for (size_t i=0; i < set->count; i++) {
+        pattern_t *pattern = &set->patterns[i];
+        int32_t state = 0;
+        for (size_t j=0; j < pattern->anchor_size; j++) {
+            uint8_t byte = pattern->bytes[pattern->anchor_offset + j];
+            int32_t *transition = &transitions[(size_t)state * 256 + byte];
+            if (*transition == -1) {
+                *transition = (int32_t)set->state_count;
+                memset(&transitions[set->state_count * 256], 0xff, 256 * sizeof(int32_t));
+                set->states[set->state_count++] = (pattern_state_t){.patterns = -1, .output = -1};
+            }
+            state = *transition;
+        }
+        pattern->next = set->states[state].patterns;
+        set->states[state].patterns = (int32_t)i;
+    }
+
+    size_t queue_start = 0, queue_end = 0;
+    for (int byte=0; byte < 256; byte++) {
+        int32_t child = transitions[byte];
+        if (child == -1) {
+            transitions[byte] = 0;
+        } else {
+            failures[child] = 0;
+            queue[queue_end++] = child;
+        }
+    }
+    while (queue_start < queue_end) {
+        int32_t state = queue[queue_start++];
+        int32_t failure = failures[state];
+        set->states[state].output = (set->states[failure].patterns != -1) ? failure : set->states[failure].output;
+        for (int byte=0; byte < 256; byte++) {
+            int32_t *transition = &transitions[(size_t)state * 256 + byte];
+            int32_t fallback = transitions[(size_t)failure * 256 + byte];
+            if (*transition == -1) {
+                *transition = fallback;
+            } else {
+                failures[*transition] = fallback;
+                queue[queue_end++] = *transition;
+            }
+        }
+    }
+    free(failures);
+    free(queue);
+
+    // Flag transitions into states that report matches, so the search loop
+    // only looks at the states themselves on a match
+    for (size_t i=0; i < set->state_count * 256; i++) {
+        const pattern_state_t *target = &set->states[transitions[i]];
+        if (target->patterns != -1 || target->output != -1) {
+            transitions[i] = ~transitions[i];
+        }
+    }
+
+    for (int byte=0; byte < 256; byte++) {
+        if (transitions[byte] != 0) {
+            set->first[byte] = true;
+            set->first_bytes[set->first_byte_count++] = (uint8_t)byte;
+        }
+    }
+    select_skip(set);
+    return true;
+}
+
+
+pattern_set_t *pattern_set_compile(const char *const *texts, size_t count) {
+    pattern_set_t *set = calloc(1, sizeof(pattern_set_t));
+    if (set == NULL) {
+        fprintf(stderr, "error: out of memory while allocating pattern set\n");
+        return NULL;
+    }
+    if (count == 0 || count > INT32_MAX) {
+        fprintf(stderr, "error: no patterns to search for\n");
+        goto FAIL;
+    }
+    set->patterns = calloc(count, sizeof(pattern_t));
+    if (set->patterns == NULL) {
+        fprintf(stderr, "error: out of memory while allocating patterns\n");
+        goto FAIL;
+    }
+
+    for (size_t i=0; i < count; i++) {
+        pattern_t *pattern = &set->patterns[i];
+        set->count++;
+        if (!pattern_parse(pattern, texts[i])) {
+            goto FAIL;
+        }
+        set->max_size = MAX(set->max_size, pattern->size);
+
+        bool zero_matches = true;
+        for (size_t j=0; j < pattern->size && zero_matches; j++) {
+            zero_matches = (pattern->bytes[j] == 0);
+        }
+        set->zero_matches = set->zero_matches || zero_matches;
+    }
+
+    if (!build_automaton(set)) {
+        goto FAIL;
+    }
+    return set;
+
+  FAIL:
+    pattern_set_free(set);
+    return NULL;
+}
+
+
+// Checks the whole pattern for every anchor that ends at end, which is one
+// past the last byte the automaton read
+static bool report_matches(const pattern_set_t *set, int32_t state, const uint8_t *buffer, size_t size, size_t end, size_t from, pattern_match_callback_t callback, void *context) {
+    if (set->states[state].patterns == -1) {
+        state = set->states[state].output;
+    }
+    for (; state != -1; state = set->states[state].output) {
+        for (int32_t index = set->states[state].patterns; index != -1; index = set->patterns[index].next) {
+            const pattern_t *pattern = &set->patterns[index];
+            size_t prefix = pattern->anchor_offset + pattern->anchor_size;
+            if (end < prefix) {
+                continue;
+            }
+            size_t start = end - prefix;
+            if (start + pattern->size > size || start + pattern->size <= from) {
+                continue;
+            }
+            size_t i = 0;
+            while (i < pattern->size && (buffer[start + i] & pattern->mask[i]) == pattern->bytes[i]) {
+                i++;
+            }
+            if (i == pattern->size && !callback(context, (size_t)index, start)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+// Reports every match that lies within the buffer and ends past from. The
+// bytes before from were already searched as the end of the previous
+// buffer, matches that end there were reported then.
+bool pattern_set_search(const pattern_set_t *set, const uint8_t *buffer, size_t size, size_t from, pattern_match_callback_t callback, void *context) {
+    const int32_t *transitions = set->transitions;
+    int32_t state = 0;
+    size_t position = 0;
+    while (position < size) {
+        if (state == 0) {
+            position = set->skip(set, buffer, size, position);
+            if (position == size) {
+                break;
+            }
+        }
+        state = transitions[(size_t)state * 256 + buffer[position++]];
+        if (state < 0) {
+            state = ~state;
+            if (!report_matches(set, state, buffer, size, position, from, callback, context)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void pattern_set_free(pattern_set_t *set) {
+    if (set == NULL) {
+        return;
+    }
+    for (size_t i=0; i < set->count; i++) {
+        free(set->patterns[i].bytes);
+        free(set->patterns[i].mask);
+    }
+    free(set->patterns);
+    free(set->transitions);
+    free(set->states);
+    free(set);
+}
@@ -0,0 +1,465 @@
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+
+#include "job_pool.h"
+#include "pointer_map.h"
+
+
+#define POINTER_CHUNK_SIZE 65536
+#define POINTER_RADIX_BITS 8
+#define POINTER_RADIX_SIZE (1 << POINTER_RADIX_BITS)
+#define POINTER_RADIX_DIGITS ((64 + POINTER_RADIX_BITS - 1) / POINTER_RADIX_BITS)
+
+
+// Mapped memory a pointer may point into, neighbouring regions merged
+typedef struct pointer_range {
+    size_t start;
+    size_t end;
+} pointer_range_t;
+
+
+typedef struct pointer_job {
+    region_job_t region;
+    pointer_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    scan_stats_t stats;
+} pointer_job_t;
+
+
+typedef struct pointer_pool {
+    int fd;
+    const pointer_range_t *ranges;
+    size_t range_count;
+    pointer_job_t *jobs;
+} pointer_pool_t;
+
+
+static bool range_contains(const pointer_range_t *ranges, size_t range_count, size_t address) {
+    if (range_count == 0 || address < ranges[0].start || address >= ranges[range_count - 1].end) {
+        return false;
+    }
+    size_t low = 0;
+    size_t high = range_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (address < ranges[middle].start) {
+            high = middle;
+        } else if (address >= ranges[middle].end) {
+            low = middle + 1;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static bool job_push(pointer_job_t *job, uint64_t target, uint64_t address) {
+    if (job->count == job->capacity) {
+        size_t new_capacity = MAX(job->capacity * 2, 1024);
+        pointer_entry_t *resized_entries = realloc(job->entries, new_capacity * sizeof(pointer_entry_t));
+        if (resized_entries == NULL) {
+            fprintf(stderr, "error: out of memory while building pointer map\n");
+            return false;
+        }
+        job->capacity = new_capacity;
+        job->entries = resized_entries;
+    }
+    job->entries[job->count].target = target;
+    job->entries[job->count].address = address;
+    job->count++;
+    return true;
+}
+
+
+// Collects every aligned pointer sized value of the job that points into
+// mapped memory. A read that fails ends the job early rather than the
+// whole build, regions can be unmapped while the subject runs between
+// maps being read and stopping it.
+static bool pointer_job_run(void *context, size_t job_index) {
+    pointer_pool_t *pool = context;
+    pointer_job_t *job = &pool->jobs[job_index];
+    uint64_t chunk[POINTER_CHUNK_SIZE / sizeof(uint64_t)];
+    // The policy's address bounds may cut a region anywhere
+    size_t offset = (job->region.offset + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    size_t end = job->region.offset + job->region.size;
+    uint64_t job_start = clock_ns();
+    while (offset < end) {
+        ssize_t read_result = pread(pool->fd, chunk, MIN(end - offset, POINTER_CHUNK_SIZE), (off_t)offset);
+        job->stats.syscalls++;
+        if (read_result <= 0) {
+            break;
+        }
+        job->stats.bytes_read += (size_t)read_result;
+
+        size_t value_count = (size_t)read_result / sizeof(uint64_t);
+        for (size_t i=0; i < value_count; i++) {
+            if (range_contains(pool->ranges, pool->range_count, chunk[i]) && !job_push(job, chunk[i], offset + i * sizeof(uint64_t))) {
+                return false;
+            }
+        }
+        offset += (size_t)read_result;
+    }
+    job->stats.region_count = 1;
+    job->stats.region_ns = clock_ns() - job_start;
+    job->stats.region_max_ns = job->stats.region_ns;
+    return true;
+}
+
+
+// LSD radix sort on target. The counts of every digit are gathered in one
+// read of the entries, and digits all entries share are skipped, which
+// leaves four or five scatter passes for user space addresses.
+static bool sort_entries(pointer_entry_t *entries, size_t count) {
+    pointer_entry_t *scratch = malloc(MAX(count, 1) * sizeof(pointer_entry_t));
+    size_t (*counts)[POINTER_RADIX_SIZE] = calloc(POINTER_RADIX_DIGITS, sizeof(*counts));
+    if (scratch == NULL || counts == NULL) {
+        fprintf(stderr, "error: out of memory while sorting pointer map\n");
+        free(scratch);
+        free(counts);
+        return false;
+    }
+
+    for (size_t i=0; i < count; i++) {
+        uint64_t target = entries[i].target;
+        for (unsigned digit=0; digit < POINTER_RADIX_DIGITS; digit++) {
+            counts[digit][(target >> (digit * POINTER_RADIX_BITS)) & (POINTER_RADIX_SIZE - 1)]++;
+        }
+    }
+
+    pointer_entry_t *source = entries;
+    pointer_entry_t *destination = scratch;
+    for (unsigned digit=0; digit < POINTER_RADIX_DIGITS && count > 0; digit++) {
+        unsigned shift = digit * POINTER_RADIX_BITS;
+        size_t *digit_counts = counts[digit];
+        if (digit_counts[(source[0].target >> shift) & (POINTER_RADIX_SIZE - 1)] == count) {
+            continue;
+        }
+        size_t total = 0;
+        for (size_t bucket=0; bucket < POINTER_RADIX_SIZE; bucket++) {
+            size_t bucket_count = digit_counts[bucket];
+            digit_counts[bucket] = total;
+            total += bucket_count;
+        }
+        for (size_t i=0; i < count; i++) {
+            destination[digit_counts[(source[i].target >> shift) & (POINTER_RADIX_SIZE - 1)]++] = source[i];
+        }
+        pointer_entry_t *swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != entries) {
+        memcpy(entries, source, count * sizeof(pointer_entry_t));
+    }
+    free(counts);
+    free(scratch);
+    return true;
+}
+
+
+// Groups the mappings of each file into one module. An anonymous writable
+// mapping that starts where a module ends is its .bss and joins it.
+static pointer_module_t *find_modules(const maps_t *maps, size_t *module_count) {
+    pointer_module_t *modules = calloc(MAX(maps->region_count, 1), sizeof(pointer_module_t));
+    if (modules == NULL) {
+        fprintf(stderr, "error: out of memory while listing modules\n");
+        return NULL;
+    }
+    *module_count = 0;
+    pointer_module_t *current = NULL;
+    for (size_t i=0; i < maps->region_count; i++) {
+        const region_t *region = &maps->regions[i];
+        region_kind_e kind = region_kind(region);
+        if (kind == REGION_MODULE) {
+            if (current == NULL || strcmp(current->filename, region->filename) != 0) {
+                current = &modules[(*module_count)++];
+                current->start = region->offset;
+                current->base = region->offset;
+                current->filename = region->filename;
+            }
+            current->end = region->offset + region->size;
+        } else if (kind == REGION_ANONYMOUS && current != NULL && region->write && region->offset == current->end) {
+            current->end = region->offset + region->size;
+        } else {
+            current = NULL;
+        }
+    }
+    return modules;
+}
+
+
+// Reads every writable region the subject's region policy allows, in
+// parallel across its worker count, and indexes the values that point into
+// a readable region
+pointer_map_t *pointer_map_build(subject_t *subject) {
+    pointer_map_t *map = calloc(1, sizeof(pointer_map_t));
+    pointer_range_t *ranges = NULL;
+    pointer_job_t *jobs = NULL;
+    size_t job_count = 0;
+    bool success = false;
+    if (map == NULL) {
+        fprintf(stderr, "error: out of memory while building pointer map\n");
+        return NULL;
+    }
+
+    if (!subject_stop(subject)) {
+        free(map);
+        return NULL;
+    }
+
+    map->maps = read_maps(subject->pid);
+    if (map->maps == NULL) {
+        goto EXIT;
+    }
+    const maps_t *maps = map->maps;
+    map->modules = find_modules(maps, &map->module_count);
+    ranges = calloc(MAX(maps->region_count, 1), sizeof(pointer_range_t));
+    if (map->modules == NULL || ranges == NULL) {
+        fprintf(stderr, "error: out of memory while building pointer map\n");
+        goto EXIT;
+    }
+
+    size_t range_count = 0;
+    for (size_t i=0; i < maps->region_count; i++) {
+        const region_t *region = &maps->regions[i];
+        if (!region->read || region_kind(region) == REGION_SPECIAL) {
+            continue;
+        }
+        if (range_count > 0 && ranges[range_count - 1].end == region->offset) {
+            ranges[range_count - 1].end = region->offset + region->size;
+        } else {
+            ranges[range_count].start = region->offset;
+            ranges[range_count].end = region->offset + region->size;
+            range_count++;
+        }
+    }
+
+    // Pointers are looked for where scans look for values, every readable
+    // region stays a possible target
+    region_policy_t policy = subject->policy;
+    policy.writable = true;
+    region_job_t *region_jobs = split_regions(maps, &policy, &job_count);
+    if (region_jobs == NULL) {
+        goto EXIT;
+    }
+    jobs = calloc(MAX(job_count, 1), sizeof(pointer_job_t));
+    if (jobs == NULL) {
+        fprintf(stderr, "error: out of memory while allocating pointer jobs\n");
+        free(region_jobs);
+        goto EXIT;
+    }
+    for (size_t i=0; i < job_count; i++) {
+        jobs[i].region = region_jobs[i];
+    }
+    free(region_jobs);
+
+    pointer_pool_t pool = {
+        .fd = subject->memory_fd,
+        .ranges = ranges,
+        .range_count = range_count,
+        .jobs = jobs,
+    };
+    job_pool_t job_pool = {
+        .run = pointer_job_run,
+        .context = &pool,
+        .job_count = job_count,
+    };
+    if (!job_pool_run(&job_pool, subject->worker_count)) {
+        goto EXIT;
+    }
+
+    for (size_t i=0; i < job_count; i++) {
+        map->count += jobs[i].count;
+        subject_add_stats(subject, &jobs[i].stats);
+    }
+    map->entries = malloc(MAX(map->count, 1) * sizeof(pointer_entry_t));
+    if (map->entries == NULL) {
+        fprintf(stderr, "error: out of memory while building pointer map\n");
+        goto EXIT;
+    }
+    size_t entry_count = 0;
+    for (size_t i=0; i < job_count; i++) {
+        memcpy(map->entries + entry_count, jobs[i].entries, jobs[i].count * sizeof(pointer_entry_t));
+        entry_count += jobs[i].count;
+        free(jobs[i].entries);
+        jobs[i].entries = NULL;
+    }
+    success = sort_entries(map->entries, map->count);
+
+  EXIT:
+    if (!subject_resume(subject)) {
+        success = false;
+    }
+    for (size_t i=0; i < job_count; i++) {
+        free(jobs[i].entries);
+    }
+    free(jobs);
+    free(ranges);
+    if (!success) {
+        pointer_map_free(map);
+        return NULL;
+    }
+    return map;
+}
+
+
+// Index of the first entry whose target is at least target
+size_t pointer_map_lower_bound(const pointer_map_t *map, uint64_t target) {
+    size_t low = 0;
+    size_t high = map->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (map->entries[middle].target < target) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+
+const pointer_module_t *pointer_map_module(const pointer_map_t *map, size_t address) {
+    size_t low = 0;
+    size_t high = map->module_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const pointer_module_t *module = &map->modules[middle];
+        if (address < module->start) {
+            high = middle;
+        } else if (address >= module->end) {
+            low = middle + 1;
+        } else {
+            return module;
+        }
+    }
+    return NULL;
+}
+
+
+void pointer_scan_options_init(pointer_scan_options_t *options) {
+    options->max_depth = 4;
+    options->max_offset = 4096;
+    options->max_results = 256;
+    options->max_nodes = 1 << 20;
+}
+
+
+// An address reached by the search. The pointer stored at address plus
+// offset gives the parent's address, the root is the target itself.
+typedef struct pointer_node {
+    size_t address;
+    size_t offset;
+    size_t parent;
+} pointer_node_t;
+
+
+// Open addressing set of visited addresses, sized for max_nodes
+typedef struct address_set {
+    size_t *slots;
+    size_t mask;
+} address_set_t;
+
+
+static bool address_set_insert(address_set_t *set, size_t address) {
+    // Zero marks an empty slot, and is never a pointer that was indexed
+    size_t slot = (address * 0x9e3779b97f4a7c15ull) & set->mask;
+    while (set->slots[slot] != 0) {
+        if (set->slots[slot] == address) {
+            return false;
+        }
+        slot = (slot + 1) & set->mask;
+    }
+    set->slots[slot] = address;
+    return true;
+}
+
+
+// Reports the path through a module pointer at address whose value plus
+// offset is the address of node parent
+static bool report_path(const pointer_node_t *nodes, size_t parent, size_t address, size_t offset, const pointer_module_t *module, pointer_path_callback_t callback, void *context) {
+    size_t offsets[POINTER_MAX_DEPTH];
+    size_t depth = 0;
+    offsets[depth++] = offset;
+    for (size_t i=parent; nodes[i].parent != SIZE_MAX; i = nodes[i].parent) {
+        offsets[depth++] = nodes[i].offset;
+    }
+    return callback(context, module, address - module->base, offsets, depth);
+}
+
+
+// Walks the reverse index breadth first from address, so shorter paths are
+// reported first. Each level looks up the pointers into
+// [address - max_offset, address] of every address of the previous level.
+// Pointers stored in a module end a path, the others are visited at the
+// next level.
+bool pointer_map_find_paths(const pointer_map_t *map, size_t address, const pointer_scan_options_t *options, pointer_path_callback_t callback, void *context) {
+    size_t max_depth = MIN(options->max_depth, POINTER_MAX_DEPTH);
+    size_t max_nodes = MAX(options->max_nodes, 1);
+    size_t set_capacity = 1;
+    while (set_capacity < max_nodes * 2) {
+        set_capacity *= 2;
+    }
+
+    bool success = false;
+    pointer_node_t *nodes = malloc(max_nodes * sizeof(pointer_node_t));
+    address_set_t visited = {.slots = calloc(set_capacity, sizeof(size_t)), .mask = set_capacity - 1};
+    if (nodes == NULL || visited.slots == NULL) {
+        fprintf(stderr, "error: out of memory while searching pointer paths\n");
+        goto EXIT;
+    }
+
+    size_t node_count = 1;
+    size_t result_count = 0;
+    nodes[0] = (pointer_node_t){.address = address, .offset = 0, .parent = SIZE_MAX};
+    address_set_insert(&visited, address);
+
+    size_t level_start = 0;
+    for (size_t depth=0; depth < max_depth && level_start < node_count; depth++) {
+        size_t level_end = node_count;
+        for (size_t i=level_start; i < level_end; i++) {
+            size_t node_address = nodes[i].address;
+            size_t low = (node_address > options->max_offset) ? node_address - options->max_offset : 0;
+            for (size_t entry=pointer_map_lower_bound(map, low); entry < map->count && map->entries[entry].target <= node_address; entry++) {
+                const pointer_entry_t *pointer = &map->entries[entry];
+                size_t offset = node_address - pointer->target;
+                const pointer_module_t *module = pointer_map_module(map, pointer->address);
+                if (module != NULL) {
+                    if (!report_path(nodes, i, pointer->address, offset, module, callback, context) || ++result_count == options->max_results) {
+                        success = true;
+                        goto EXIT;
+                    }
+                    continue;
+                }
+                if (node_count == max_nodes || !address_set_insert(&visited, pointer->address)) {
+                    continue;
+                }
+                nodes[node_count++] = (pointer_node_t){.address = pointer->address, .offset = offset, .parent = i};
+            }
+        }
+        level_start = level_end;
+    }
+    success = true;
+
+  EXIT:
+    free(nodes);
+    free(visited.slots);
+    return success;
+}
+
+
+void pointer_map_free(pointer_map_t *map) {
+    if (map == NULL) {
+        return;
+    }
+    free(map->entries);
+    free(map->modules);
+    free_maps(map->maps);
+    free(map);
+}
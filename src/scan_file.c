@@ -0,0 +1,247 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scan_file.h"
+
+
+#define SCAN_FILE_BUFFER (1024 * 1024)
+
+
+static uint64_t align_up(uint64_t value) {
+    return (value + 7) & ~(uint64_t)7;
+}
+
+
+static uint32_t region_flags(const region_t *region) {
+    uint32_t flags = 0;
+    flags |= region->read ? SCAN_FILE_READ : 0;
+    flags |= region->write ? SCAN_FILE_WRITE : 0;
+    flags |= region->exec ? SCAN_FILE_EXEC : 0;
+    flags |= region->shared ? SCAN_FILE_SHARED : 0;
+    return flags;
+}
+
+
+// Writes the header, region table and names. The record count in the
+// header is filled in by scan_writer_close.
+bool scan_writer_open(scan_writer_t *writer, const char *path, uint32_t type, size_t alignment, pid_t pid, const maps_t *maps) {
+    memset(writer, 0, sizeof(scan_writer_t));
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        fprintf(stderr, "error: failed to open '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, SCAN_FILE_BUFFER);
+
+    // Offset 0 holds the empty name shared by every anonymous region
+    uint64_t names_size = 1;
+    for (size_t i=0; i < maps->region_count; i++) {
+        if (maps->regions[i].filename[0] != '\0') {
+            names_size += strlen(maps->regions[i].filename) + 1;
+        }
+    }
+    if (names_size > UINT32_MAX) {
+        fprintf(stderr, "error: region names too large for '%s'\n", path);
+        goto FAIL;
+    }
+
+    scan_file_header_t *header = &writer->header;
+    memcpy(header->magic, SCAN_FILE_MAGIC, sizeof(header->magic));
+    header->version = SCAN_FILE_VERSION;
+    header->type = type;
+    header->alignment = alignment;
+    header->pid = pid;
+    header->region_count = maps->region_count;
+    header->names_size = names_size;
+    header->records_offset = align_up(sizeof(scan_file_header_t) + maps->region_count * sizeof(scan_file_region_t) + names_size);
+    if (fwrite(header, sizeof(scan_file_header_t), 1, writer->file) != 1) {
+        goto WRITE_FAIL;
+    }
+
+    uint32_t name = 1;
+    for (size_t i=0; i < maps->region_count; i++) {
+        const region_t *region = &maps->regions[i];
+        scan_file_region_t entry = {
+            .start = region->offset,
+            .end = region->offset + region->size,
+            .file_offset = region->file_offset,
+            .flags = region_flags(region),
+            .name = 0,
+        };
+        if (region->filename[0] != '\0') {
+            entry.name = name;
+            name += (uint32_t)strlen(region->filename) + 1;
+        }
+        if (fwrite(&entry, sizeof(entry), 1, writer->file) != 1) {
+            goto WRITE_FAIL;
+        }
+    }
+
+    if (fputc('\0', writer->file) == EOF) {
+        goto WRITE_FAIL;
+    }
+    for (size_t i=0; i < maps->region_count; i++) {
+        const char *filename = maps->regions[i].filename;
+        if (filename[0] != '\0' && fwrite(filename, strlen(filename) + 1, 1, writer->file) != 1) {
+            goto WRITE_FAIL;
+        }
+    }
+
+    static const uint8_t padding[8] = {0};
+    size_t padding_size = header->records_offset - (sizeof(scan_file_header_t) + maps->region_count * sizeof(scan_file_region_t) + names_size);
+    if (padding_size > 0 && fwrite(padding, padding_size, 1, writer->file) != 1) {
+        goto WRITE_FAIL;
+    }
+    return true;
+
+  WRITE_FAIL:
+    fprintf(stderr, "error: failed to write '%s': %s\n", path, strerror(errno));
+  FAIL:
+    fclose(writer->file);
+    writer->file = NULL;
+    return false;
+}
+
+
+// Appends records, which must continue the ascending address order
+bool scan_writer_write(scan_writer_t *writer, const scan_file_record_t *records, size_t count) {
+    for (size_t i=0; i < count; i++) {
+        if (writer->header.record_count + i > 0 && records[i].address <= writer->last_address) {
+            fprintf(stderr, "error: scan file records out of order\n");
+            return false;
+        }
+        writer->last_address = records[i].address;
+    }
+    if (count > 0 && fwrite(records, sizeof(scan_file_record_t), count, writer->file) != count) {
+        fprintf(stderr, "error: failed to write scan file: %s\n", strerror(errno));
+        return false;
+    }
+    writer->header.record_count += count;
+    return true;
+}
+
+
+bool scan_writer_close(scan_writer_t *writer) {
+    if (writer->file == NULL) {
+        return false;
+    }
+    bool success = (
+        fseek(writer->file, 0, SEEK_SET) == 0
+        && fwrite(&writer->header, sizeof(scan_file_header_t), 1, writer->file) == 1
+    );
+    if (fclose(writer->file) != 0) {
+        success = false;
+    }
+    writer->file = NULL;
+    if (!success) {
+        fprintf(stderr, "error: failed to finish scan file: %s\n", strerror(errno));
+    }
+    return success;
+}
+
+
+// Maps the file and checks that every section lies within it
+scan_file_t *scan_file_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "error: failed to open '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    scan_file_t *file = NULL;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        fprintf(stderr, "error: failed to stat '%s': %s\n", path, strerror(errno));
+        goto EXIT;
+    }
+    size_t size = (size_t)file_stat.st_size;
+    if (size < sizeof(scan_file_header_t)) {
+        fprintf(stderr, "error: '%s' is not a scan file\n", path);
+        goto EXIT;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "error: failed to map '%s': %s\n", path, strerror(errno));
+        goto EXIT;
+    }
+
+    const scan_file_header_t *header = data;
+    uint64_t regions_end = sizeof(scan_file_header_t) + header->region_count * sizeof(scan_file_region_t);
+    if (memcmp(header->magic, SCAN_FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != SCAN_FILE_VERSION) {
+        fprintf(stderr, "error: '%s' is not a version %d scan file\n", path, SCAN_FILE_VERSION);
+        munmap(data, size);
+        goto EXIT;
+    }
+    if (
+        header->region_count > size / sizeof(scan_file_region_t)
+        || header->names_size == 0 || header->names_size > size
+        || header->records_offset < regions_end + header->names_size
+        || header->records_offset % 8 != 0 || header->records_offset > size
+        || header->record_count > (size - header->records_offset) / sizeof(scan_file_record_t)
+        || ((const char *)data)[regions_end + header->names_size - 1] != '\0'
+    ) {
+        fprintf(stderr, "error: '%s' is truncated or corrupt\n", path);
+        munmap(data, size);
+        goto EXIT;
+    }
+
+    file = malloc(sizeof(scan_file_t));
+    if (file == NULL) {
+        fprintf(stderr, "error: out of memory while opening scan file\n");
+        munmap(data, size);
+        goto EXIT;
+    }
+    file->data = data;
+    file->size = size;
+    file->header = header;
+    file->regions = (const scan_file_region_t *)((const uint8_t *)data + sizeof(scan_file_header_t));
+    file->names = (const char *)data + regions_end;
+    file->records = (const scan_file_record_t *)((const uint8_t *)data + header->records_offset);
+
+  EXIT:
+    close(fd);
+    return file;
+}
+
+
+// Region holding address, found by binary search of the sorted region
+// table, or NULL
+const scan_file_region_t *scan_file_region(const scan_file_t *file, uint64_t address) {
+    size_t low = 0;
+    size_t high = file->header->region_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const scan_file_region_t *region = &file->regions[middle];
+        if (address < region->start) {
+            high = middle;
+        } else if (address >= region->end) {
+            low = middle + 1;
+        } else {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+
+const char *scan_file_region_name(const scan_file_t *file, const scan_file_region_t *region) {
+    if (region == NULL || region->name >= file->header->names_size) {
+        return "";
+    }
+    return file->names + region->name;
+}
+
+
+void scan_file_close(scan_file_t *file) {
+    if (file == NULL) {
+        return;
+    }
+    munmap(file->data, file->size);
+    free(file);
+}
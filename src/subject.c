@@ -2,42 +2,83 @@
 #define _POSIX_C_SOURCE 1
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/ptrace.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 
+#include "job_pool.h"
+#include "kernels.h"
+#include "maps.h"
+#include "pattern.h"
 #include "subject.h"
 
 
-typedef struct region
-{
-    size_t offset;
-    size_t size;
-    bool read;
-    bool write;
-    bool exec;
-    char filename[256];
-} region_t;
+#define FILTER_BATCH_SPANS 1024
+#define FILTER_BATCH_BYTES 65536
+#define FILTER_BATCH_HITS 16384
+#define PAGEMAP_WINDOW 512
+#define PAGEMAP_SOFT_DIRTY (1ull << 55)
+#define PAGEMAP_SWAPPED (1ull << 62)
+#define PAGEMAP_PRESENT (1ull << 63)
+#define WRITE_BATCH_SPANS 1024
+#define FREEZE_INTERVAL_MS 100
+#define ASYNC_STREAM_HITS 1024
+#define SCAN_CHUNK_SIZE 65536
+// Space reserved in front of each chunk for the carried bytes, which can be
+// as long as a string needle. A multiple of the cache line size, so
+// naturally aligned values stay aligned in the chunk buffer.
+#define SCAN_CARRY_ROOM SCAN_STRING_MAX
+// Bytes of a snapshot region summarized by one zone of its index, one page
+// on most systems so dirty pages map onto zones
+#define SNAPSHOT_ZONE_SIZE 4096
+
+
+// Monotonic clock in nanoseconds, for the times in scan_stats_t
+uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
 
 
-typedef struct maps {
-    region_t *regions;
-    size_t region_count;
-} maps_t;
+static void stats_add(scan_stats_t *total, const scan_stats_t *stats) {
+    total->bytes_read += stats->bytes_read;
+    total->bytes_written += stats->bytes_written;
+    total->syscalls += stats->syscalls;
+    total->stop_count += stats->stop_count;
+    total->stop_ns += stats->stop_ns;
+    total->region_count += stats->region_count;
+    total->region_ns += stats->region_ns;
+    total->region_max_ns = MAX(total->region_max_ns, stats->region_max_ns);
+    total->compare_ns += stats->compare_ns;
+    total->hits += stats->hits;
+    total->reallocs += stats->reallocs;
+}
+
+
+// Adds the counters of an operation outside of any scan to the subject
+void subject_add_stats(subject_t *subject, const scan_stats_t *stats) {
+    stats_add(&subject->stats, stats);
+}
 
 
-static int open_maps(pid_t pid) {
-    char maps_path[32] = {0};
-    snprintf(maps_path, 31, "/proc/%d/maps", pid);
-    return open(maps_path, O_RDONLY);
+// Adds the counters of one operation to the scan and its subject
+static void record_stats(scan_t *scan, const scan_stats_t *stats) {
+    stats_add(&scan->stats, stats);
+    stats_add(&scan->subject->stats, stats);
 }
 
 
@@ -48,464 +89,2368 @@ static int memory_open(pid_t pid) {
 }
 
 
-static bool get_next_line(int fd, char *buffer, size_t buffer_size) {
-    size_t line_length = 0;
-    while (line_length < buffer_size - 1) {
-        char c;
-        if (read(fd, &c, 1) <= 0) {
-            buffer[line_length] = '\0';
-            return line_length > 0;
-        }
-        if (c == '\r') {
-            continue;
-        }
-        if (c == '\n') {
-            buffer[line_length] = '\0';
-            return true;
-        }
-        buffer[line_length++] = c;
-    }
-    // Line buffer full, discard until EOF or \n
-    while (true) {
-        char c;
-        if (read(fd, &c, 1) <= 0) {
-            break;
-        }
-        if (c == '\n') {
-            break;
-        }
-    }
-    buffer[line_length] = '\0';
-    return true;
+static int pagemap_open(pid_t pid) {
+    char pagemap_path[32] = {0};
+    snprintf(pagemap_path, 31, "/proc/%d/pagemap", pid);
+    return open(pagemap_path, O_RDONLY);
 }
 
 
-static maps_t *read_maps(pid_t pid) {
-    maps_t *maps = calloc(1, sizeof(maps_t));
-    size_t region_capacity = 32;
-    maps->regions = malloc(region_capacity * sizeof(region_t));
+typedef struct snapshot_region {
+    size_t offset;
+    size_t size;
+    uint8_t *data;
+    bool priority;
+    bool anonymous;
+    // Index of the region's first zone in snapshot_t::zones
+    size_t first_zone;
+} snapshot_region_t;
+
+
+// Smallest and largest value of the scan's type that starts in one zone
+typedef struct zone {
+    scan_value_u min;
+    scan_value_u max;
+} zone_t;
+
+
+// Copy of every rw region, stored back to back in one allocation. Holds the
+// previous value of every address for the relative search ops. One copy is
+// taken for all the scans that share it, each of which holds a reference
+// and its own zone map over the data.
+typedef struct snapshot {
+    snapshot_region_t *regions;
+    size_t region_count;
+    uint8_t *data;
+    size_t size;
+    // Zones of every region, for the zone map of each scan
+    size_t zone_count;
+    size_t refs;
+} snapshot_t;
+
+
+// Window of /proc/<pid>/pagemap entries, refilled with one read whenever a
+// page outside of it is looked up
+typedef struct pagemap {
+    int fd;
+    size_t page_size;
+    size_t first_page;
+    size_t count;
+    uint64_t entries[PAGEMAP_WINDOW];
+} pagemap_t;
+
+
+static void pagemap_init(pagemap_t *pagemap, int fd) {
+    pagemap->fd = fd;
+    pagemap->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    pagemap->first_page = 0;
+    pagemap->count = 0;
+}
+
 
-    int fd = open_maps(pid);
-    if (fd == -1) {
-        fprintf(stderr, "error: failed to open /proc/<pid>/maps: %s\n", strerror(errno));
-        free(maps);
-        return NULL;
+// Entry of the page holding address. Pages whose entry cannot be read look
+// present and dirty, so they are always read.
+static uint64_t pagemap_entry(pagemap_t *pagemap, size_t address, scan_stats_t *stats) {
+    size_t page = address / pagemap->page_size;
+    if (page < pagemap->first_page || page >= pagemap->first_page + pagemap->count) {
+        ssize_t read_result = pread(pagemap->fd, pagemap->entries, sizeof(pagemap->entries), (off_t)(page * sizeof(uint64_t)));
+        stats->syscalls++;
+        pagemap->first_page = page;
+        pagemap->count = (read_result > 0) ? (size_t)read_result / sizeof(uint64_t) : 0;
+        if (pagemap->count == 0) {
+            return PAGEMAP_PRESENT | PAGEMAP_SOFT_DIRTY;
+        }
     }
+    return pagemap->entries[page - pagemap->first_page];
+}
 
-    char line[1024] = {0};
-    while (get_next_line(fd, line, sizeof(line) - 1)) {
-        unsigned long start, end;
-        char read, write, exec, cow;
-        int offset, dev_major, dev_minor, inode;
-        char filename[256] = {0};
 
-        int scan_result = sscanf(
-            line, "%lx-%lx %c%c%c%c %x %x:%x %u %[^\n]", &start, &end, &read,
-            &write, &exec, &cow, &offset, &dev_major, &dev_minor, &inode, filename
-        );
-        if (scan_result < 6) {
-            continue;
-        }
+// Whether the page of entry still holds what was read when soft-dirty bits
+// were last cleared: it is present or swapped out and was not written since.
+// Pages that were unmapped or dropped since have no soft-dirty bit either.
+static bool pagemap_entry_clean(uint64_t entry) {
+    return (entry & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED)) != 0 && (entry & PAGEMAP_SOFT_DIRTY) == 0;
+}
 
-        if (maps->region_count == region_capacity) {
-            region_capacity *= 2;
-            maps->regions = realloc(maps->regions, region_capacity * sizeof(region_t));
-        }
-        region_t *region = &maps->regions[maps->region_count++];
-        region->offset = start;
-        region->size = end - start;
-        region->read = (read == 'r');
-        region->write = (write == 'w');
-        region->exec = (exec == 'x');
-        strcpy(region->filename, filename);
-    }
 
-    close(fd);
-    return maps;
+static bool pagemap_clean(pagemap_t *pagemap, size_t address, scan_stats_t *stats) {
+    return pagemap_entry_clean(pagemap_entry(pagemap, address, stats));
 }
 
 
-static void print_maps(maps_t *maps) {
-    printf("Offset           Size     RWX Name\n");
-    for (size_t i=0; i < maps->region_count; i++) {
-        region_t *region = maps->regions + i;
-        printf("%016zx %08zx %c%c%c %s\n", region->offset, region->size, (region->read?'r':'-'), (region->write?'w':'-'), (region->exec?'x':'-'), region->filename);
+typedef enum page_source_e {
+    PAGE_READ,
+    // Private anonymous page that was never touched or was dropped, it
+    // reads as zeros
+    PAGE_ZERO,
+    // Clean since the snapshot was synced
+    PAGE_SNAPSHOT,
+} page_source_e;
+
+
+static page_source_e page_source(pagemap_t *pagemap, size_t address, bool anonymous, bool use_snapshot, scan_stats_t *stats) {
+    uint64_t entry = pagemap_entry(pagemap, address, stats);
+    if (anonymous && !(entry & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED))) {
+        return PAGE_ZERO;
     }
+    if (use_snapshot && pagemap_entry_clean(entry)) {
+        return PAGE_SNAPSHOT;
+    }
+    return PAGE_READ;
 }
 
 
-static void free_maps(maps_t *maps) {
-    if (maps == NULL) {
+// Scan running on its own thread, see subject_update_scans_async. Counters
+// are updated by the scan workers and read by subject_scan_progress.
+typedef struct async_scan {
+    pthread_t thread;
+    scan_t **scans;
+    scan_value_u *values;
+    size_t scan_count;
+    search_op_e op;
+    scan_hits_callback_t callback;
+    void *context;
+    // Serializes callback calls
+    pthread_mutex_t callback_lock;
+    atomic_uint_fast64_t bytes_done;
+    atomic_uint_fast64_t bytes_total;
+    atomic_uint_fast64_t regions_done;
+    atomic_uint_fast64_t region_count;
+    atomic_uint_fast64_t hits;
+    atomic_bool cancelled;
+    atomic_bool finished;
+    bool success;
+} async_scan_t;
+
+
+static bool async_cancelled(async_scan_t *async) {
+    return async != NULL && atomic_load(&async->cancelled);
+}
+
+
+static void async_emit(async_scan_t *async, scan_t *scan, const scan_file_record_t *records, size_t count) {
+    atomic_fetch_add(&async->hits, count);
+    if (async->callback == NULL || count == 0) {
         return;
     }
-    free(maps->regions);
-    free(maps);
+    pthread_mutex_lock(&async->callback_lock);
+    async->callback(async->context, scan, records, count);
+    pthread_mutex_unlock(&async->callback_lock);
+}
+
+
+// Strings longer than a record keep only their first bytes
+static void set_record(scan_file_record_t *record, size_t address, const uint8_t *value, size_t value_size) {
+    record->address = address;
+    memset(record->value, 0, sizeof(record->value));
+    memcpy(record->value, value, MIN(value_size, sizeof(record->value)));
+}
+
+
+// Values held in place by the freeze thread, one remote span per hit of the
+// scan when the freeze started
+typedef struct freeze {
+    scan_t *scan;
+    scan_value_u value;
+    size_t value_size;
+    struct iovec *remote;
+    size_t span_count;
+    struct freeze *next;
+} freeze_t;
+
+
+typedef struct scan_job {
+    region_job_t region;
+    uint8_t *snapshot;
+    // One result per lane of the pool
+    struct scan_result *results;
+    // Reads and time of this job, shared by every lane
+    scan_stats_t stats;
+} scan_job_t;
+
+
+typedef struct scan_result {
+    hit_set_t hits;
+    value_column_t values;
+    uint64_t compare_ns;
+} scan_result_t;
+
+
+// One scan fed by a pool. Every lane sees the same chunks of memory.
+typedef struct scan_lane {
+    scan_t *scan;
+    search_op_e op;
+    scan_value_u needle;
+    // What the kernels compare against: needle, or the string or group of
+    // the scan
+    const void *kernel_needle;
+    // Bytes equal searches at byte alignment look for with memmem, NULL
+    // when a match is not a plain run of bytes, as for floats
+    const uint8_t *needle_bytes;
+    size_t needle_size;
+    size_t alignment;
+    scan_kernel_t kernel;
+    // Whether a value of all zero bytes can be a hit, lanes that cannot
+    // skip windows of zero pages
+    bool zero_matches;
+} scan_lane_t;
+
+
+typedef struct scan_pool {
+    bool (*run)(struct scan_pool *pool, scan_job_t *job);
+    int fd;
+    scan_lane_t *lanes;
+    size_t lane_count;
+    // Searched for instead of the lanes by pattern_search
+    const pattern_set_t *patterns;
+    size_t carry_size;
+    // Subject's pagemap, -1 to read every page
+    int pagemap_fd;
+    // Snapshot pages that are clean since the last pass are copied from the
+    // snapshot instead of read
+    bool use_snapshot;
+    scan_job_t *jobs;
+    size_t job_count;
+    // Progress and cancellation of a background scan, or NULL
+    async_scan_t *async;
+} scan_pool_t;
+
+
+static bool result_push_hit(scan_result_t *result, size_t hit, const uint8_t *value) {
+    return value_column_append(&result->values, value) && hit_set_append(&result->hits, hit);
 }
 
 
-static void generic_retrieve(scan_type_e type, void *dst, const void *src) {
-    if (type == SCANTYPE_FLOAT32) {
-        *(float*)dst = *(float*)src;
-    } else if (type == SCANTYPE_FLOAT64) {
-        *(double*)dst = *(double*)src;
+// Hands the hits a job found for a lane to the background scan's callback
+static void job_emit_hits(async_scan_t *async, scan_lane_t *lane, scan_result_t *result) {
+    scan_file_record_t records[ASYNC_STREAM_HITS];
+    size_t record_count = 0;
+    size_t index = 0;
+    hit_iter_t iter;
+    size_t hit;
+    hit_iter_start(&iter, &result->hits);
+    while (hit_iter_next(&iter, &hit)) {
+        set_record(&records[record_count++], hit, value_column_get(&result->values, index++), lane->needle_size);
+        if (record_count == ASYNC_STREAM_HITS) {
+            async_emit(async, lane->scan, records, record_count);
+            record_count = 0;
+        }
     }
+    async_emit(async, lane->scan, records, record_count);
 }
 
 
-static bool generic_compare(scan_type_e type, search_op_e op, const void *a, const void *b) {
-    if (op == SEARCH_NOOP) {
+// Searches the positions of the window that start at or after the first
+// position not already covered by the previous window and before the end of
+// the job. The window begins with the bytes carried over from the previous
+// chunk, so values that straddle two reads are still seen. Positions are
+// multiples of the scan's alignment in the subject's address space.
+static bool chunk_search(scan_lane_t *lane, scan_result_t *result, uint8_t *window, size_t window_size, size_t window_offset, size_t chunk_offset, size_t end, const uint8_t *previous, uint64_t *mask) {
+    size_t needle_size = lane->needle_size;
+    size_t alignment = lane->alignment;
+
+    size_t start = MAX(window_offset, chunk_offset - MIN(chunk_offset, needle_size - 1));
+    start = (start + alignment - 1) / alignment * alignment;
+    size_t stop = MIN(window_offset + window_size, end + needle_size - 1);
+    if (stop < start + needle_size) {
+        return true;
+    }
+
+    uint8_t *buffer = window + (start - window_offset);
+    size_t buffer_size = stop - start;
+
+    // memmem is the fastest way to find every byte offset of a value
+    if (lane->op == SEARCH_EQUAL && alignment == 1 && lane->needle_bytes != NULL) {
+        uint8_t *cursor = buffer;
+        size_t cursor_size = buffer_size;
+        uint8_t *match;
+        while ((match = memmem(cursor, cursor_size, lane->needle_bytes, needle_size))) {
+            if (!result_push_hit(result, start + (match - buffer), match)) {
+                return false;
+            }
+            cursor_size -= ((match + 1) - cursor);
+            cursor = match + 1;
+        }
         return true;
     }
 
-    if (type == SCANTYPE_FLOAT32) {
-        if (op == SEARCH_EQUAL) {
-            return *(float*)a == *(float*)b;
-        } else if (op == SEARCH_GREATER) {
-            return *(float*)a >= *(float*)b;
-        } else if (op == SEARCH_LESS) {
-            return *(float*)a <= *(float*)b;
-        } else if (op == SEARCH_APPROX) {
-            float a_value = *(float*)a;
-            float b_value = *(float*)b;
-            return (a_value >= b_value - 1.5f) && (a_value <= b_value + 1.5f);
+    if (previous != NULL) {
+        previous += start - window_offset;
+    }
+
+    size_t value_count = (buffer_size - needle_size) / alignment + 1;
+    size_t word_count = kernel_mask_words(value_count);
+    lane->kernel.mask(buffer, value_count, alignment, search_op_is_relative(lane->op) ? previous : lane->kernel_needle, mask);
+
+    for (size_t word=0; word < word_count; word++) {
+        uint64_t bits = mask[word];
+        while (bits != 0) {
+            size_t i = (word * 64 + (size_t)__builtin_ctzll(bits)) * alignment;
+            if (!result_push_hit(result, start + i, buffer + i)) {
+                return false;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return true;
+}
+
+
+// Fills chunk with the size bytes at offset. With a pagemap, runs of pages
+// that read as zero are cleared and runs that are clean since the snapshot
+// was synced are copied from the snapshot, only the rest is read. Sets
+// *zero when every byte came from zero pages.
+static ssize_t job_read(scan_pool_t *pool, scan_job_t *job, pagemap_t *pagemap, uint8_t *chunk, size_t offset, size_t size, bool *zero) {
+    bool use_snapshot = pool->use_snapshot && job->snapshot != NULL;
+    *zero = false;
+    if (pagemap == NULL || (!job->region.anonymous && !use_snapshot)) {
+        ssize_t read_result = pread(pool->fd, chunk, size, (off_t)offset);
+        job->stats.syscalls++;
+        if (read_result > 0) {
+            job->stats.bytes_read += (size_t)read_result;
+        }
+        return read_result;
+    }
+
+    size_t page_size = pagemap->page_size;
+    size_t done = 0;
+    *zero = true;
+    while (done < size) {
+        size_t position = offset + done;
+        page_source_e source = page_source(pagemap, position, job->region.anonymous, use_snapshot, &job->stats);
+        size_t run_end = MIN((position / page_size + 1) * page_size, offset + size);
+        while (run_end < offset + size && page_source(pagemap, run_end, job->region.anonymous, use_snapshot, &job->stats) == source) {
+            run_end = MIN(run_end + page_size, offset + size);
+        }
+
+        if (source == PAGE_ZERO) {
+            memset(chunk + done, 0, run_end - position);
+            done = run_end - offset;
+            continue;
+        }
+        *zero = false;
+        if (source == PAGE_SNAPSHOT) {
+            memcpy(chunk + done, job->snapshot + (position - job->region.offset), run_end - position);
+            done = run_end - offset;
+            continue;
+        }
+
+        ssize_t read_result = pread(pool->fd, chunk + done, run_end - position, (off_t)position);
+        job->stats.syscalls++;
+        if (read_result <= 0) {
+            return (done > 0) ? (ssize_t)done : read_result;
         }
-    } else if (type == SCANTYPE_FLOAT64) {
-        if (op == SEARCH_EQUAL) {
-            return *(double*)a == *(double*)b;
-        } else if (op == SEARCH_GREATER) {
-            return *(double*)a >= *(double*)b;
-        } else if (op == SEARCH_LESS) {
-            return *(double*)a <= *(double*)b;
-        } else if (op == SEARCH_APPROX) {
-            double a_value = *(double*)a;
-            double b_value = *(double*)b;
-            return (a_value >= b_value - 1.5) && (a_value <= b_value + 1.5);
+        job->stats.bytes_read += (size_t)read_result;
+        done += (size_t)read_result;
+        if ((size_t)read_result < run_end - position) {
+            break;
         }
     }
-    return false;
+    return (ssize_t)done;
 }
 
 
-static bool memory_search(scan_t *scan, int fd, size_t offset, size_t size, void *needle, size_t needle_size, search_op_e op) {
-    if (lseek(fd, offset, SEEK_SET) == -1) {
-        fprintf(stderr, "error: failed to lseek memory file: %s\n", strerror(errno));
-        return false;
+// Reads the job one chunk at a time and hands every chunk to each lane, so
+// scans of several types cost a single pass over the subject's memory. The
+// last bytes of each chunk are carried to the front of the next one and the
+// final read runs past the end of the job by the overlap, so no value is
+// missed at a chunk or job boundary and no extra reads are issued for it.
+// A region can be unmapped or shrink while it is read, so a failed read
+// ends the job rather than the search.
+static bool memory_search(scan_pool_t *pool, scan_job_t *job) {
+    uint64_t job_start = clock_ns();
+    size_t end = job->region.offset + job->region.size;
+    size_t read_end = end + MIN(job->region.overlap, pool->carry_size);
+    size_t offset = job->region.offset;
+    size_t carried = 0;
+
+    _Alignas(64) uint8_t buffer[SCAN_CARRY_ROOM + SCAN_CHUNK_SIZE];
+    uint64_t mask[(SCAN_CARRY_ROOM + SCAN_CHUNK_SIZE + 63) / 64];
+    uint8_t *chunk = buffer + SCAN_CARRY_ROOM;
+
+    pagemap_t pagemap;
+    if (pool->pagemap_fd != -1) {
+        pagemap_init(&pagemap, pool->pagemap_fd);
     }
 
-    uint8_t buffer[65536];
-    size_t bytes_remaining = size;
-    while (bytes_remaining > 0) {
-        size_t read_size = MIN(bytes_remaining, 65536);
-        ssize_t read_result = read(fd, buffer, read_size);
-        if (read_result < 0) {
+    while (offset < read_end) {
+        if (async_cancelled(pool->async)) {
             return false;
         }
-        else if (read_result == 0) {
+        bool zero;
+        ssize_t read_result = job_read(pool, job, (pool->pagemap_fd != -1) ? &pagemap : NULL, chunk, offset, MIN(read_end - offset, SCAN_CHUNK_SIZE), &zero);
+        if (read_result <= 0) {
             break;
         }
-        bytes_remaining -= (size_t)read_result;
 
-        uint8_t *cursor = buffer;
-        size_t cursor_size = (size_t)read_result;
-        uint8_t *match;
+        uint8_t *window = chunk - carried;
+        size_t window_offset = offset - carried;
+        size_t window_size = carried + (size_t)read_result;
 
-        if (op == SEARCH_EQUAL) {
-            while ((match = memmem(cursor, cursor_size, needle, needle_size))) {
-                if (scan->hit_count < 32) {
-                    generic_retrieve(scan->type, scan->values + scan->hit_count, match);
-                }
-                if (scan->hit_count == scan->hit_capacity) {
-                    scan->hit_capacity *= 2;
-                    scan->hits = realloc(scan->hits, scan->hit_capacity * sizeof(size_t));
-                    if (scan->hits == NULL) {
-                        return false;
-                    }
-                }
-                scan->hits[scan->hit_count++] = offset + (match - buffer);
-                cursor_size -= ((match + needle_size) - cursor);
-                cursor = match + needle_size;
+        uint8_t *previous = NULL;
+        if (job->snapshot != NULL) {
+            previous = job->snapshot + (window_offset - job->region.offset);
+        }
+
+        for (size_t i=0; zero && i < carried; i++) {
+            zero = (window[i] == 0);
+        }
+
+        for (size_t i=0; i < pool->lane_count; i++) {
+            if (zero && !pool->lanes[i].zero_matches) {
+                continue;
             }
-        } else {
-            for (size_t i=0; i + needle_size < cursor_size; i += needle_size) {
-                if (generic_compare(scan->type, op, cursor + i, needle)) {
-                    if (scan->hit_count < 32) {
-                        generic_retrieve(scan->type, scan->values + scan->hit_count, cursor + i);
-                    }
-                    if (scan->hit_count == scan->hit_capacity) {
-                        scan->hit_capacity *= 2;
-                        scan->hits = realloc(scan->hits, scan->hit_capacity * sizeof(size_t));
-                        if (scan->hits == NULL) {
-                            return false;
-                        }
-                    }
-                    scan->hits[scan->hit_count++] = offset + i;
-                }
+            uint64_t compare_start = clock_ns();
+            if (!chunk_search(&pool->lanes[i], &job->results[i], window, window_size, window_offset, offset, end, previous, mask)) {
+                return false;
             }
+            job->results[i].compare_ns += clock_ns() - compare_start;
         }
 
+        if (pool->async != NULL && offset < end) {
+            atomic_fetch_add(&pool->async->bytes_done, MIN((size_t)read_result, end - offset));
+        }
         offset += (size_t)read_result;
-    }
+        carried = MIN(pool->carry_size, window_size);
 
-    return true;
-}
+        memmove(chunk - carried, window + window_size - carried, carried);
+    }
 
+    job->stats.region_count = 1;
+    job->stats.region_ns = clock_ns() - job_start;
+    job->stats.region_max_ns = job->stats.region_ns;
 
-static bool memory_filter(scan_t *scan, int fd, void *value, size_t value_size, search_op_e op) {
-    uint8_t buffer[sizeof(scan_value_u)];
-    size_t old_hit_count = scan->hit_count;
-    scan->hit_count = 0;
-    for (size_t i=0; i < old_hit_count; i++) {
-        size_t hit_location = scan->hits[i];
-        lseek(fd, hit_location, SEEK_SET);
-        read(fd, buffer, value_size);
-        if (generic_compare(scan->type, op, buffer, value)) {
-            if (scan->hit_count < 32) {
-                generic_retrieve(scan->type, scan->values + scan->hit_count, buffer);
-            }
-            scan->hits[scan->hit_count++] = hit_location;
+    if (pool->async != NULL) {
+        for (size_t i=0; i < pool->lane_count; i++) {
+            job_emit_hits(pool->async, &pool->lanes[i], &job->results[i]);
+        }
+        if (job->region.last) {
+            atomic_fetch_add(&pool->async->regions_done, 1);
         }
     }
     return true;
 }
 
 
-static void push_scan(scan_t *scan) {
-    scan->next = scan->subject->scans;
-    scan->prev = NULL;
-    scan->subject->scans = scan;
-    if (scan->next != NULL) {
-        scan->next->prev = scan;
-    }
+static bool scan_pool_job(void *context, size_t job) {
+    scan_pool_t *pool = context;
+    return pool->run(pool, &pool->jobs[job]);
 }
 
 
-static void pop_scan(scan_t *scan) {
-    if (scan->prev != NULL) {
-        scan->prev->next = scan->next;
-    }
-    if (scan->next != NULL) {
-        scan->next->prev = scan->prev;
-    }
-    if (scan->subject->scans == scan) {
-        scan->subject->scans = scan->next;
+typedef struct pattern_window {
+    scan_job_t *job;
+    size_t offset;
+} pattern_window_t;
+
+
+static bool push_pattern_match(void *context, size_t pattern, size_t position) {
+    pattern_window_t *window = context;
+    scan_job_t *job = window->job;
+    size_t address = window->offset + position;
+    if (address < job->region.offset || address >= job->region.offset + job->region.size) {
+        return true;
     }
+    return hit_set_append(&job->results[pattern].hits, address);
 }
 
 
-subject_t *subject_create(pid_t pid) {
-    subject_t *subject = calloc(1, sizeof(subject_t));
-    subject->pid = pid;
-
-    if (ptrace(PTRACE_ATTACH, pid, 0L, 0L) == -1) {
-        fprintf(stderr, "error: failed to ptrace attach: %s\n", strerror(errno));
-        subject_free(subject);
-        return NULL;
+// Reads the job in chunks like memory_search and runs the pool's patterns
+// over every window, carrying the last bytes of each chunk so a match that
+// straddles two reads is still found. Code regions include mappings such
+// as [vvar] that cannot be read, so a failed read ends the job rather than
+// the search.
+static bool pattern_search(scan_pool_t *pool, scan_job_t *job) {
+    const pattern_set_t *set = pool->patterns;
+    uint64_t job_start = clock_ns();
+    size_t read_end = job->region.offset + job->region.size + MIN(job->region.overlap, pool->carry_size);
+    size_t offset = job->region.offset;
+    size_t carried = 0;
+
+    _Alignas(64) uint8_t buffer[PATTERN_MAX_SIZE + SCAN_CHUNK_SIZE];
+    uint8_t *chunk = buffer + PATTERN_MAX_SIZE;
+
+    pagemap_t pagemap;
+    if (pool->pagemap_fd != -1) {
+        pagemap_init(&pagemap, pool->pagemap_fd);
     }
 
-    int status;
-    if (waitpid(pid, &status, 0) == -1) {
-        fprintf(stderr, "error: failed to waitpid: %s\n", strerror(errno));
-        subject_free(subject);
-        subject = NULL;
-    }
+    while (offset < read_end) {
+        bool zero;
+        ssize_t read_result = job_read(pool, job, (pool->pagemap_fd != -1) ? &pagemap : NULL, chunk, offset, MIN(read_end - offset, SCAN_CHUNK_SIZE), &zero);
+        if (read_result <= 0) {
+            break;
+        }
 
-    if (ptrace(PTRACE_DETACH, pid, 0L, 0L) == -1) {
-        fprintf(stderr, "error: failed to ptrace detach: %s\n", strerror(errno));
-        subject_free(subject);
-        return NULL;
+        uint8_t *window = chunk - carried;
+        size_t window_size = carried + (size_t)read_result;
+        for (size_t i=0; zero && i < carried; i++) {
+            zero = (window[i] == 0);
+        }
+
+        if (!zero || set->zero_matches) {
+            pattern_window_t context = {.job = job, .offset = offset - carried};
+            uint64_t compare_start = clock_ns();
+            if (!pattern_set_search(set, window, window_size, carried, push_pattern_match, &context)) {
+                return false;
+            }
+            job->stats.compare_ns += clock_ns() - compare_start;
+        }
+
+        offset += (size_t)read_result;
+        carried = MIN(pool->carry_size, window_size);
+        memmove(chunk - carried, window + window_size - carried, carried);
     }
 
-    return subject;
+    job->stats.region_count = 1;
+    job->stats.region_ns = clock_ns() - job_start;
+    job->stats.region_max_ns = job->stats.region_ns;
+    return true;
 }
 
 
-scan_t *subject_begin_scan(subject_t *subject, scan_type_e type) {
-    if (subject == NULL) {
-        return NULL;
+// Copies the job into its part of the snapshot. Like memory_search, a failed
+// or short read ends the job, the bytes that could not be read are zeroed.
+static bool snapshot_read(scan_pool_t *pool, scan_job_t *job) {
+    uint64_t job_start = clock_ns();
+    size_t bytes_read = 0;
+    while (bytes_read < job->region.size) {
+        ssize_t read_result = pread(pool->fd, job->snapshot + bytes_read, job->region.size - bytes_read, (off_t)(job->region.offset + bytes_read));
+        job->stats.syscalls++;
+        if (read_result <= 0) {
+            break;
+        }
+        bytes_read += (size_t)read_result;
     }
-
-    scan_t *scan = malloc(sizeof(scan_t));
-    scan->subject = (subject_t *)subject;
-    scan->type = type;
-    scan->hits = NULL;
-    scan->hit_count = 0;
-    scan->hit_capacity = 0;
-
-    push_scan(scan);
-    return scan;
+    memset(job->snapshot + bytes_read, 0, job->region.size - bytes_read);
+    job->stats.bytes_read = bytes_read;
+    job->stats.region_count = 1;
+    job->stats.region_ns = clock_ns() - job_start;
+    job->stats.region_max_ns = job->stats.region_ns;
+    return true;
 }
 
 
-void subject_free(subject_t *subject) {
-    if (subject == NULL) {
-        return;
+// Wraps every region job in a scan job, region_jobs is freed
+static scan_job_t *make_scan_jobs(region_job_t *region_jobs, size_t job_count) {
+    scan_job_t *jobs = NULL;
+    if (region_jobs != NULL) {
+        jobs = calloc(MAX(job_count, 1), sizeof(scan_job_t));
+        if (jobs == NULL) {
+            fprintf(stderr, "error: out of memory while allocating scan jobs\n");
+        }
     }
-    while (subject->scans != NULL) {
-        scan_free(subject->scans);
+    for (size_t i=0; jobs != NULL && i < job_count; i++) {
+        jobs[i].region = region_jobs[i];
     }
-    free(subject);
+    free(region_jobs);
+    return jobs;
 }
 
 
-size_t scan_type_size(scan_type_e type) {
-    switch (type)
-    {
-        case SCANTYPE_UINT8: return sizeof(uint8_t);
-        case SCANTYPE_UINT16: return sizeof(uint16_t);
-        case SCANTYPE_UINT32: return sizeof(uint32_t);
-        case SCANTYPE_UINT64: return sizeof(uint64_t);
-        case SCANTYPE_INT8: return sizeof(int8_t);
-        case SCANTYPE_INT16: return sizeof(int16_t);
-        case SCANTYPE_INT32: return sizeof(int32_t);
-        case SCANTYPE_INT64: return sizeof(int64_t);
-        case SCANTYPE_FLOAT32: return sizeof(float);
-        case SCANTYPE_FLOAT64: return sizeof(double);
+static scan_job_t *split_scan_regions(maps_t *maps, const region_policy_t *policy, size_t *job_count) {
+    region_job_t *region_jobs = split_regions(maps, policy, job_count);
+    return make_scan_jobs(region_jobs, *job_count);
+}
+
+
+static scan_job_t *split_snapshot(snapshot_t *snapshot, size_t *job_count) {
+    region_job_t *region_jobs = NULL;
+    size_t job_capacity = 0;
+    *job_count = 0;
+    for (size_t i=0; i < snapshot->region_count; i++) {
+        snapshot_region_t *region = &snapshot->regions[i];
+        if (!push_region_jobs(&region_jobs, job_count, &job_capacity, region->offset, region->size, region->priority, region->anonymous)) {
+            free(region_jobs);
+            return NULL;
+        }
     }
-    return 0;
+    if (region_jobs == NULL) {
+        region_jobs = calloc(1, sizeof(region_job_t));
+    }
+    scan_job_t *jobs = make_scan_jobs(region_jobs, *job_count);
+
+    // Jobs are in region order
+    size_t region_index = 0;
+    for (size_t i=0; jobs != NULL && i < *job_count; i++) {
+        snapshot_region_t *region = &snapshot->regions[region_index];
+        while (jobs[i].region.offset >= region->offset + region->size) {
+            region = &snapshot->regions[++region_index];
+        }
+        jobs[i].snapshot = region->data + (jobs[i].region.offset - region->offset);
+    }
+    return jobs;
 }
 
 
-scan_t *scan_fork(scan_t *scan) {
-    scan_t *result = malloc(sizeof(scan_t));
-    memcpy(result, scan, sizeof(scan_t));
-    result->hits = malloc(sizeof(size_t) * scan->hit_count);
-    memcpy(result->hits, scan->hits, sizeof(size_t) * scan->hit_count);
-    push_scan(result);
-    return result;
+// Runs every job of the pool across the subject's worker threads, in order
+// or the given order. Each job collects its own hits.
+static bool pool_run(scan_pool_t *pool, const size_t *order, size_t worker_count) {
+    job_pool_t job_pool = {
+        .run = scan_pool_job,
+        .context = pool,
+        .job_count = pool->job_count,
+        .order = order,
+    };
+    return job_pool_run(&job_pool, worker_count);
 }
 
 
-bool scan_refresh(scan_t *scan) {
-    int memory_fd = -1;
+// Searches every job across the worker pool for every lane, then stitches
+// each lane's per-job hit sets back together in job (and therefore address)
+// order. Jobs with a snapshot compare every lane against the same copy.
+static bool memory_search_jobs(subject_t *subject, scan_lane_t *lanes, size_t lane_count, scan_job_t *jobs, size_t job_count, bool use_snapshot) {
     bool success = false;
-    bool attached = false;
-    subject_t *subject = scan->subject;
-    pid_t pid = subject->pid;
+    size_t *order = NULL;
+
+    scan_pool_t pool = {
+        .run = memory_search,
+        .fd = subject->memory_fd,
+        .lanes = lanes,
+        .lane_count = lane_count,
+        .pagemap_fd = subject->pagemap_fd,
+        .use_snapshot = use_snapshot,
+        .jobs = jobs,
+        .job_count = job_count,
+        .async = subject->async,
+    };
+
+    scan_result_t *results = calloc(MAX(job_count * lane_count, 1), sizeof(scan_result_t));
+    if (results == NULL) {
+        fprintf(stderr, "error: out of memory while allocating scan results\n");
+        return false;
+    }
+    for (size_t i=0; i < job_count; i++) {
+        jobs[i].results = results + i * lane_count;
+        for (size_t j=0; j < lane_count; j++) {
+            value_column_init(&jobs[i].results[j].values, lanes[j].needle_size);
+        }
+    }
+    for (size_t i=0; i < lane_count; i++) {
+        pool.carry_size = MAX(pool.carry_size, lanes[i].needle_size - 1);
+    }
+    if (pool.async != NULL) {
+        for (size_t i=0; i < job_count; i++) {
+            atomic_fetch_add(&pool.async->bytes_total, jobs[i].region.size);
+            atomic_fetch_add(&pool.async->region_count, jobs[i].region.last ? 1 : 0);
+        }
+    }
 
-    if (ptrace(PTRACE_ATTACH, pid, 0L, 0L) == -1) {
-        fprintf(stderr, "error: failed to ptrace attach: %s\n", strerror(errno));
+    // Priority jobs are searched first, results are still merged in address
+    // order
+    order = malloc(MAX(job_count, 1) * sizeof(size_t));
+    if (order == NULL) {
+        fprintf(stderr, "error: out of memory while allocating scan job order\n");
         goto EXIT;
     }
-    attached = true;
+    size_t order_count = 0;
+    for (size_t i=0; i < job_count; i++) {
+        if (jobs[i].region.priority) {
+            order[order_count++] = i;
+        }
+    }
+    for (size_t i=0; i < job_count; i++) {
+        if (!jobs[i].region.priority) {
+            order[order_count++] = i;
+        }
+    }
 
-    int status;
-    if (waitpid(pid, &status, 0) == -1) {
-        fprintf(stderr, "error: failed to waitpid: %s\n", strerror(errno));
+    if (!pool_run(&pool, order, subject->worker_count)) {
         goto EXIT;
     }
 
-    memory_fd = memory_open(pid);
-    if (memory_fd == -1) {
-        fprintf(stderr, "error: failed to open /proc/<pid>/mem: %s\n", strerror(errno));
-        goto EXIT;
+    scan_stats_t job_stats = {0};
+    for (size_t i=0; i < job_count; i++) {
+        stats_add(&job_stats, &jobs[i].stats);
     }
+    stats_add(&subject->stats, &job_stats);
+
+    for (size_t lane_index=0; lane_index < lane_count; lane_index++) {
+        scan_t *scan = lanes[lane_index].scan;
+        scan_stats_t lane_stats = {0};
+        hit_set_clear(&scan->hits);
+        value_column_clear(&scan->values);
+        for (size_t i=0; i < job_count; i++) {
+            scan_result_t *result = &jobs[i].results[lane_index];
+            if (!hit_set_concat(&scan->hits, &result->hits) || !value_column_concat(&scan->values, &result->values)) {
+                goto EXIT;
+            }
+            lane_stats.compare_ns += result->compare_ns;
+            lane_stats.reallocs += result->hits.realloc_count + result->values.realloc_count;
+        }
+        scan->searched = true;
 
-    if (!memory_filter(scan, memory_fd, NULL, scan_type_size(scan->type), SEARCH_NOOP)) {
-        goto EXIT;
+        lane_stats.hits = scan->hits.count;
+        lane_stats.reallocs += scan->hits.realloc_count + scan->values.realloc_count;
+        stats_add(&subject->stats, &lane_stats);
+        stats_add(&lane_stats, &job_stats);
+        stats_add(&scan->stats, &lane_stats);
     }
 
     success = true;
 
   EXIT:
-    if (attached) {
-        if (ptrace(PTRACE_DETACH, pid, 0L, 0L) == -1) {
-            fprintf(stderr, "error: failed to ptrace detach: %s\n", strerror(errno));
-            return false;
-        }
-    }
-    if (memory_fd != -1) {
-        close(memory_fd);
+    for (size_t i=0; i < job_count * lane_count; i++) {
+        hit_set_clear(&results[i].hits);
+        value_column_clear(&results[i].values);
     }
-
+    free(results);
+    free(order);
     return success;
 }
 
 
-void scan_eliminate(scan_t *scan, size_t index) {
-    if (index >= scan->hit_count) {
+static void free_snapshot(snapshot_t *snapshot) {
+    if (snapshot == NULL) {
         return;
     }
+    free(snapshot->regions);
+    free(snapshot->data);
+    free(snapshot);
+}
+
 
-    if (index < scan->hit_count - 1) {
-        memmove(scan->hits + index, scan->hits + index + 1, (scan->hit_count - index) * sizeof(size_t));
+// Drops one scan's reference, the last one frees the snapshot
+static void release_snapshot(snapshot_t *snapshot) {
+    if (snapshot != NULL && --snapshot->refs == 0) {
+        free_snapshot(snapshot);
     }
-    scan->hit_count--;
 }
 
 
-bool scan_update(scan_t *scan, search_op_e op, ...) {
-    int memory_fd = -1;
-    bool success = false;
-    bool attached = false;
-    subject_t *subject = scan->subject;
-    pid_t pid = subject->pid;
+static snapshot_t *create_snapshot(maps_t *maps, const region_policy_t *policy) {
+    snapshot_t *snapshot = calloc(1, sizeof(snapshot_t));
+    if (snapshot == NULL) {
+        fprintf(stderr, "error: out of memory while allocating snapshot\n");
+        return NULL;
+    }
+    snapshot->regions = calloc(MAX(maps->region_count, 1), sizeof(snapshot_region_t));
+    if (snapshot->regions == NULL) {
+        fprintf(stderr, "error: out of memory while allocating snapshot regions\n");
+        free_snapshot(snapshot);
+        return NULL;
+    }
 
-    scan_value_u value;
-    va_list args;
-    va_start(args, op);
+    for (size_t i=0; i < maps->region_count; i++) {
+        region_t *region = &maps->regions[i];
+        size_t offset, size;
+        if (!region_policy_apply(policy, region, &offset, &size)) {
+            continue;
+        }
+        snapshot_region_t *snapshot_region = &snapshot->regions[snapshot->region_count++];
+        snapshot_region->offset = offset;
+        snapshot_region->size = size;
+        snapshot_region->priority = region_policy_prioritized(policy, region);
+        snapshot_region->anonymous = region_zero_filled(region);
+        snapshot_region->first_zone = snapshot->zone_count;
+        snapshot->size += size;
+        snapshot->zone_count += (size + SNAPSHOT_ZONE_SIZE - 1) / SNAPSHOT_ZONE_SIZE;
+    }
 
-    switch (scan->type)
-    {
-        case SCANTYPE_UINT8: value.uint8 = (uint8_t)va_arg(args, unsigned); break;
-        case SCANTYPE_UINT16: value.uint16 = (uint16_t)va_arg(args, unsigned); break;
-        case SCANTYPE_UINT32: value.uint32 = va_arg(args, uint32_t); break;
-        case SCANTYPE_UINT64: value.uint64 = va_arg(args, uint64_t); break;
-        case SCANTYPE_INT8: value.int8 = (int8_t)va_arg(args, int); break;
-        case SCANTYPE_INT16: value.int16 = (int16_t)va_arg(args, int); break;
-        case SCANTYPE_INT32: value.int32 = va_arg(args, int32_t); break;
-        case SCANTYPE_INT64: value.int64 = va_arg(args, int64_t); break;
-        case SCANTYPE_FLOAT32: value.float32 = (float)va_arg(args, double); break;
-        case SCANTYPE_FLOAT64: value.float64 = va_arg(args, double); break;
+    snapshot->data = malloc(MAX(snapshot->size, 1));
+    if (snapshot->data == NULL) {
+        fprintf(stderr, "error: failed to allocate %zu byte snapshot: %s\n", snapshot->size, strerror(errno));
+        free_snapshot(snapshot);
+        return NULL;
+    }
+    size_t data_offset = 0;
+    for (size_t i=0; i < snapshot->region_count; i++) {
+        snapshot->regions[i].data = snapshot->data + data_offset;
+        data_offset += snapshot->regions[i].size;
     }
+    return snapshot;
+}
 
-    va_end(args);
 
-    if (ptrace(PTRACE_ATTACH, pid, 0L, 0L) == -1) {
-        fprintf(stderr, "error: failed to ptrace attach: %s\n", strerror(errno));
-        goto EXIT;
+// Bounds of the positions in zone of region where a value of value_size
+// bytes starts that is a multiple of alignment, returns the count
+static size_t zone_positions(const snapshot_region_t *region, size_t zone, size_t value_size, size_t alignment, size_t *first) {
+    size_t start = region->offset + zone * SNAPSHOT_ZONE_SIZE;
+    if (region->size < value_size) {
+        return 0;
     }
-    attached = true;
+    size_t end = MIN(start + SNAPSHOT_ZONE_SIZE, region->offset + region->size - value_size + 1);
+    *first = (start + alignment - 1) / alignment * alignment;
+    return (*first < end) ? (end - *first + alignment - 1) / alignment : 0;
+}
 
-    int status;
-    if (waitpid(pid, &status, 0) == -1) {
-        fprintf(stderr, "error: failed to waitpid: %s\n", strerror(errno));
-        goto EXIT;
-    }
 
-    memory_fd = memory_open(pid);
-    if (memory_fd == -1) {
-        fprintf(stderr, "error: failed to open /proc/<pid>/mem: %s\n", strerror(errno));
+// Recomputes zones [from, to) of region in the scan's zone map from the
+// snapshot data
+static void zone_update(scan_t *scan, const snapshot_region_t *region, size_t from, size_t to) {
+    range_kernel_t range = range_kernel_select(scan->type);
+    size_t value_size = scan->values.value_size;
+    size_t alignment = scan->alignment;
+    for (size_t zone=from; zone < to; zone++) {
+        size_t first;
+        size_t count = zone_positions(region, zone, value_size, alignment, &first);
+        if (count > 0) {
+            zone_t *entry = &scan->zones[region->first_zone + zone];
+            range(region->data + (first - region->offset), count, alignment, &entry->min, &entry->max);
+        }
+    }
+}
+
+
+static size_t region_zone_count(const snapshot_region_t *region) {
+    return (region->size + SNAPSHOT_ZONE_SIZE - 1) / SNAPSHOT_ZONE_SIZE;
+}
+
+
+// Whether a value between the bounds of zone can pass op. The values op
+// accepts form one interval, so it is enough to compare the bounds with the
+// compare kernels of the type, indexed by op.
+static bool zone_may_match(const zone_t *zone, const compare_kernel_t *compares, search_op_e op, const scan_value_u *value) {
+    bool above_min = compares[SEARCH_LESS](&zone->min, value);
+    bool below_max = compares[SEARCH_GREATER](&zone->max, value);
+    switch (op)
+    {
+        case SEARCH_EQUAL: return above_min && below_max;
+        case SEARCH_LESS: return above_min;
+        case SEARCH_GREATER: return below_max;
+        case SEARCH_APPROX:
+            return (above_min && below_max) || compares[SEARCH_APPROX](&zone->min, value) || compares[SEARCH_APPROX](&zone->max, value);
+        default: return true;
+    }
+}
+
+
+static bool snapshot_capture(snapshot_t *snapshot, int fd, size_t worker_count, scan_stats_t *stats) {
+    size_t job_count;
+    scan_job_t *jobs = split_snapshot(snapshot, &job_count);
+    if (jobs == NULL) {
+        return false;
+    }
+
+    scan_pool_t pool = {
+        .run = snapshot_read,
+        .fd = fd,
+        .pagemap_fd = -1,
+        .jobs = jobs,
+        .job_count = job_count,
+    };
+    bool success = pool_run(&pool, NULL, worker_count);
+    if (!success) {
+        fprintf(stderr, "error: failed to read memory into snapshot\n");
+    }
+    for (size_t i=0; i < job_count; i++) {
+        stats_add(stats, &jobs[i].stats);
+    }
+    free(jobs);
+    return success;
+}
+
+
+typedef struct filter_batch {
+    struct iovec local[FILTER_BATCH_SPANS];
+    struct iovec remote[FILTER_BATCH_SPANS];
+    bool readable[FILTER_BATCH_SPANS];
+    size_t first_hit[FILTER_BATCH_SPANS + 1];
+    // Spans that have to be read when clean ones come from the snapshot
+    struct iovec dirty_local[FILTER_BATCH_SPANS];
+    struct iovec dirty_remote[FILTER_BATCH_SPANS];
+    bool dirty_readable[FILTER_BATCH_SPANS];
+    size_t dirty_index[FILTER_BATCH_SPANS];
+    size_t hits[FILTER_BATCH_HITS];
+    size_t hit_count;
+    size_t span_count;
+    size_t buffer_used;
+    uint8_t buffer[FILTER_BATCH_BYTES];
+} filter_batch_t;
+
+
+// Reads every span in one process_vm_readv call where possible. A span the
+// kernel refuses is marked unreadable and the call resumes after it. Falls
+// back to pread on the mem fd if process_vm_readv itself is unavailable.
+static void memory_read_spans(pid_t pid, int fd, struct iovec *local, struct iovec *remote, bool *readable, size_t span_count, bool *use_pread, scan_stats_t *stats) {
+    size_t span_index = 0;
+    while (span_index < span_count && !*use_pread) {
+        ssize_t read_result = process_vm_readv(
+            pid, local + span_index, span_count - span_index,
+            remote + span_index, span_count - span_index, 0
+        );
+        stats->syscalls++;
+        if (read_result == -1) {
+            if (errno != EFAULT) {
+                *use_pread = true;
+                break;
+            }
+            readable[span_index++] = false;
+            continue;
+        }
+
+        size_t bytes_read = (size_t)read_result;
+        stats->bytes_read += bytes_read;
+        while (span_index < span_count && bytes_read >= remote[span_index].iov_len) {
+            bytes_read -= remote[span_index].iov_len;
+            readable[span_index++] = true;
+        }
+        if (span_index < span_count) {
+            readable[span_index++] = false;
+        }
+    }
+
+    for (; span_index < span_count; span_index++) {
+        ssize_t read_result = pread(fd, local[span_index].iov_base, local[span_index].iov_len, (off_t)remote[span_index].iov_base);
+        readable[span_index] = (read_result == (ssize_t)local[span_index].iov_len);
+        stats->syscalls++;
+        if (read_result > 0) {
+            stats->bytes_read += (size_t)read_result;
+        }
+    }
+}
+
+
+// Writes value to every span, as few process_vm_writev calls as the kernel
+// allows. Spans it refuses, read-only pages for instance, are retried
+// through the mem fd, which also takes over entirely if process_vm_writev
+// is unavailable. Returns the number of spans that could not be written.
+static size_t memory_write_spans(pid_t pid, int fd, const void *value, size_t value_size, const struct iovec *remote, size_t span_count, scan_stats_t *stats) {
+    struct iovec local[WRITE_BATCH_SPANS];
+    for (size_t i=0; i < MIN(span_count, WRITE_BATCH_SPANS); i++) {
+        local[i].iov_base = (void *)value;
+        local[i].iov_len = value_size;
+    }
+
+    size_t failed = 0;
+    bool use_pwrite = false;
+    size_t span_index = 0;
+    while (span_index < span_count) {
+        if (!use_pwrite) {
+            size_t batch_count = MIN(span_count - span_index, WRITE_BATCH_SPANS);
+            ssize_t write_result = process_vm_writev(pid, local, batch_count, remote + span_index, batch_count, 0);
+            stats->syscalls++;
+            if (write_result == -1 && errno != EFAULT) {
+                use_pwrite = true;
+                continue;
+            }
+            size_t spans_written = (write_result > 0) ? (size_t)write_result / value_size : 0;
+            stats->bytes_written += spans_written * value_size;
+            span_index += spans_written;
+            if (spans_written == batch_count) {
+                continue;
+            }
+        }
+
+        // Span the vectored write stopped at, or every span without it
+        ssize_t write_result = pwrite(fd, value, value_size, (off_t)remote[span_index].iov_base);
+        stats->syscalls++;
+        if (write_result == (ssize_t)value_size) {
+            stats->bytes_written += value_size;
+        } else {
+            failed++;
+        }
+        span_index++;
+    }
+
+    return failed;
+}
+
+
+// Pulls hits from iter into page-bounded spans, so nearby hits share one
+// remote iovec. A hit that does not fit is left in *pending for the next
+// batch. Returns false once there are no hits left to gather.
+static bool filter_batch_gather(filter_batch_t *batch, hit_iter_t *iter, size_t *pending, bool *has_pending, size_t value_size, size_t page_size) {
+    batch->span_count = 0;
+    batch->buffer_used = 0;
+    batch->hit_count = 0;
+
+    while (batch->hit_count < FILTER_BATCH_HITS) {
+        size_t hit;
+        if (*has_pending) {
+            hit = *pending;
+            *has_pending = false;
+        } else if (!hit_iter_next(iter, &hit)) {
+            break;
+        }
+
+        if (batch->span_count > 0) {
+            struct iovec *remote = &batch->remote[batch->span_count - 1];
+            struct iovec *local = &batch->local[batch->span_count - 1];
+            size_t span_start = (size_t)remote->iov_base;
+            size_t page_end = (span_start & ~(page_size - 1)) + page_size;
+            if (hit >= span_start && hit + value_size <= page_end) {
+                size_t span_size = MAX(remote->iov_len, hit + value_size - span_start);
+                size_t growth = span_size - remote->iov_len;
+                if (batch->buffer_used + growth <= FILTER_BATCH_BYTES) {
+                    remote->iov_len = span_size;
+                    local->iov_len = span_size;
+                    batch->buffer_used += growth;
+                    batch->hits[batch->hit_count++] = hit;
+                    continue;
+                }
+                *pending = hit;
+                *has_pending = true;
+                break;
+            }
+        }
+
+        if (batch->span_count == FILTER_BATCH_SPANS || batch->buffer_used + value_size > FILTER_BATCH_BYTES) {
+            *pending = hit;
+            *has_pending = true;
+            break;
+        }
+        batch->remote[batch->span_count].iov_base = (void *)hit;
+        batch->remote[batch->span_count].iov_len = value_size;
+        batch->local[batch->span_count].iov_base = batch->buffer + batch->buffer_used;
+        batch->local[batch->span_count].iov_len = value_size;
+        batch->first_hit[batch->span_count] = batch->hit_count;
+        batch->span_count++;
+        batch->buffer_used += value_size;
+        batch->hits[batch->hit_count++] = hit;
+    }
+
+    batch->first_hit[batch->span_count] = batch->hit_count;
+    return batch->hit_count > 0;
+}
+
+
+// Reads every span of the batch. With a pagemap, the hits of spans on pages
+// that are clean since the scan was synced still hold the value of the last
+// pass, which values holds from index batch_start on. Spans on pages that
+// are neither present nor swapped out are read, so hits on memory unmapped
+// since are dropped.
+static void filter_batch_read(filter_batch_t *batch, pid_t pid, int fd, pagemap_t *pagemap, const value_column_t *values, size_t batch_start, bool *use_pread, scan_stats_t *stats) {
+    if (pagemap == NULL) {
+        memory_read_spans(pid, fd, batch->local, batch->remote, batch->readable, batch->span_count, use_pread, stats);
+        return;
+    }
+
+    size_t dirty_count = 0;
+    for (size_t i=0; i < batch->span_count; i++) {
+        size_t span_start = (size_t)batch->remote[i].iov_base;
+        size_t span_size = batch->remote[i].iov_len;
+        if (pagemap_clean(pagemap, span_start, stats) && pagemap_clean(pagemap, span_start + span_size - 1, stats)) {
+            uint8_t *span_buffer = batch->local[i].iov_base;
+            for (size_t j=batch->first_hit[i]; j < batch->first_hit[i + 1]; j++) {
+                memcpy(span_buffer + (batch->hits[j] - span_start), value_column_get(values, batch_start + j), values->value_size);
+            }
+            batch->readable[i] = true;
+            continue;
+        }
+        batch->dirty_local[dirty_count] = batch->local[i];
+        batch->dirty_remote[dirty_count] = batch->remote[i];
+        batch->dirty_index[dirty_count] = i;
+        dirty_count++;
+    }
+
+    memory_read_spans(pid, fd, batch->dirty_local, batch->dirty_remote, batch->dirty_readable, dirty_count, use_pread, stats);
+    for (size_t i=0; i < dirty_count; i++) {
+        batch->readable[batch->dirty_index[i]] = batch->dirty_readable[i];
+    }
+}
+
+
+static bool memory_filter(scan_t *scan, int fd, int pagemap_fd, const void *value, size_t value_size, search_op_e op) {
+    filter_batch_t *batch = malloc(sizeof(filter_batch_t));
+    if (batch == NULL) {
+        fprintf(stderr, "error: out of memory while allocating filter batch\n");
+        return false;
+    }
+
+    pid_t pid = scan->subject->pid;
+    bool relative = search_op_is_relative(op);
+    compare_kernel_t compare = kernel_select(scan->type, op, scan->alignment).compare;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    bool use_pread = false;
+    bool success = false;
+    hit_iter_t iter;
+    hit_set_t survivors;
+    value_column_t survivor_values;
+    size_t pending = 0;
+    bool has_pending = false;
+    // Index of the batch's first hit in the scan's hits and values
+    size_t batch_start = 0;
+    scan_stats_t stats = {0};
+    pagemap_t pagemap;
+    if (pagemap_fd != -1) {
+        pagemap_init(&pagemap, pagemap_fd);
+    }
+    async_scan_t *async = scan->subject->async;
+    scan_file_record_t *records = NULL;
+    if (async != NULL) {
+        atomic_fetch_add(&async->bytes_total, scan->hits.count * value_size);
+        if (async->callback != NULL) {
+            records = malloc(FILTER_BATCH_HITS * sizeof(scan_file_record_t));
+            if (records == NULL) {
+                fprintf(stderr, "error: out of memory while allocating filter records\n");
+                free(batch);
+                return false;
+            }
+        }
+    }
+    hit_iter_start(&iter, &scan->hits);
+    hit_set_init(&survivors);
+    value_column_init(&survivor_values, value_size);
+
+    while (filter_batch_gather(batch, &iter, &pending, &has_pending, value_size, page_size)) {
+        if (async_cancelled(async)) {
+            goto EXIT;
+        }
+        filter_batch_read(batch, pid, fd, (pagemap_fd != -1) ? &pagemap : NULL, &scan->values, batch_start, &use_pread, &stats);
+
+        size_t record_count = 0;
+        size_t batch_survivors = survivors.count;
+        uint64_t compare_start = clock_ns();
+        for (size_t span_index=0; span_index < batch->span_count; span_index++) {
+            if (!batch->readable[span_index]) {
+                continue;
+            }
+            size_t span_start = (size_t)batch->remote[span_index].iov_base;
+            uint8_t *span_buffer = batch->local[span_index].iov_base;
+            for (size_t i=batch->first_hit[span_index]; i < batch->first_hit[span_index + 1]; i++) {
+                size_t hit_location = batch->hits[i];
+                uint8_t *buffer = span_buffer + (hit_location - span_start);
+                // Relative ops compare against the value of the last pass
+                const uint8_t *last = value_column_get(&scan->values, batch_start + i);
+                if (compare(buffer, relative ? last : value)) {
+                    if (!hit_set_append(&survivors, hit_location) || !value_column_append(&survivor_values, buffer)) {
+                        goto EXIT;
+                    }
+                    if (records != NULL) {
+                        set_record(&records[record_count++], hit_location, buffer, value_size);
+                    }
+                }
+            }
+        }
+        stats.compare_ns += clock_ns() - compare_start;
+        batch_start += batch->hit_count;
+
+        if (async != NULL) {
+            atomic_fetch_add(&async->bytes_done, batch->hit_count * value_size);
+            async_emit(async, scan, records, survivors.count - batch_survivors);
+        }
+    }
+
+    stats.hits = survivors.count;
+    stats.reallocs = survivors.realloc_count + survivor_values.realloc_count;
+    record_stats(scan, &stats);
+
+    hit_set_clear(&scan->hits);
+    value_column_clear(&scan->values);
+    scan->hits = survivors;
+    scan->values = survivor_values;
+    hit_set_init(&survivors);
+    value_column_init(&survivor_values, value_size);
+    success = true;
+
+  EXIT:
+    hit_set_clear(&survivors);
+    value_column_clear(&survivor_values);
+    free(records);
+    free(batch);
+    return success;
+}
+
+
+static void push_scan(scan_t *scan) {
+    scan->next = scan->subject->scans;
+    scan->prev = NULL;
+    scan->subject->scans = scan;
+    if (scan->next != NULL) {
+        scan->next->prev = scan;
+    }
+}
+
+
+static void pop_scan(scan_t *scan) {
+    if (scan->prev != NULL) {
+        scan->prev->next = scan->next;
+    }
+    if (scan->next != NULL) {
+        scan->next->prev = scan->prev;
+    }
+    if (scan->subject->scans == scan) {
+        scan->subject->scans = scan->next;
+    }
+}
+
+
+subject_t *subject_create(pid_t pid) {
+    subject_t *subject = calloc(1, sizeof(subject_t));
+    if (subject == NULL) {
+        fprintf(stderr, "error: out of memory while allocating subject\n");
+        return NULL;
+    }
+    subject->pid = pid;
+    subject->clear_refs_fd = -1;
+    subject->freeze_interval_ms = FREEZE_INTERVAL_MS;
+    pthread_mutex_init(&subject->freeze_lock, NULL);
+    pthread_condattr_t wake_attr;
+    pthread_condattr_init(&wake_attr);
+    pthread_condattr_setclock(&wake_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&subject->freeze_wake, &wake_attr);
+    pthread_condattr_destroy(&wake_attr);
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    subject->worker_count = (cpu_count > 0) ? (size_t)cpu_count : 1;
+    region_policy_init(&subject->policy);
+
+    // Opening mem needs the same permission as ptrace attach, so this doubles
+    // as the access check without stopping the subject
+    subject->memory_fd = memory_open(pid);
+    if (subject->memory_fd == -1) {
+        fprintf(stderr, "error: failed to open /proc/<pid>/mem: %s\n", strerror(errno));
+        subject_free(subject);
+        return NULL;
+    }
+
+    // Only used to skip pages, every page is read without it
+    subject->pagemap_fd = pagemap_open(pid);
+
+    return subject;
+}
+
+
+// Skips or resumes the freeze thread's ticks. A tick that lands after a
+// scan was synced and before the bits are cleared at the end of the stop
+// would be lost to the clear, so with dirty tracking the thread writes
+// nothing while the subject is stopped. Taking the lock waits out a tick
+// already underway.
+static void freeze_pause(subject_t *subject, bool paused) {
+    pthread_mutex_lock(&subject->freeze_lock);
+    subject->freeze_paused = paused;
+    if (!paused) {
+        pthread_cond_signal(&subject->freeze_wake);
+    }
+    pthread_mutex_unlock(&subject->freeze_lock);
+}
+
+
+// Clears the soft-dirty bits for every scan synced since the last clear,
+// which become current in the epoch this starts. Only called while the
+// subject is stopped with freeze ticks paused, so no write of its own can
+// land before the clear.
+static bool subject_clear_dirty(subject_t *subject) {
+    if (!subject->dirty_clear_pending) {
+        return true;
+    }
+    subject->dirty_clear_pending = false;
+    if (pwrite(subject->clear_refs_fd, "4", 1, 0) != 1) {
+        fprintf(stderr, "error: failed to clear soft-dirty bits: %s\n", strerror(errno));
+        // Skips the epoch the synced scans were waiting for
+        subject->dirty_epoch += 2;
+        return false;
+    }
+    subject->stats.syscalls++;
+    subject->dirty_epoch++;
+    return true;
+}
+
+
+bool subject_stop(subject_t *subject) {
+    if (subject->live) {
+        return true;
+    }
+    if (subject->stop_depth++ > 0) {
+        return true;
+    }
+
+    pid_t pid = subject->pid;
+    if (ptrace(PTRACE_ATTACH, pid, 0L, 0L) == -1) {
+        fprintf(stderr, "error: failed to ptrace attach: %s\n", strerror(errno));
+        subject->stop_depth--;
+        return false;
+    }
+
+    subject->stats.stop_count++;
+    subject->stop_start = clock_ns();
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        fprintf(stderr, "error: failed to waitpid: %s\n", strerror(errno));
+        ptrace(PTRACE_DETACH, pid, 0L, 0L);
+        subject->stop_depth--;
+        return false;
+    }
+
+    if (subject->dirty_tracking) {
+        freeze_pause(subject, true);
+    }
+    return true;
+}
+
+
+bool subject_resume(subject_t *subject) {
+    if (subject->live || subject->stop_depth == 0) {
+        return true;
+    }
+    if (--subject->stop_depth > 0) {
+        return true;
+    }
+
+    bool success = subject_clear_dirty(subject);
+    if (subject->freeze_paused) {
+        freeze_pause(subject, false);
+    }
+    subject->stats.stop_ns += clock_ns() - subject->stop_start;
+    if (ptrace(PTRACE_DETACH, subject->pid, 0L, 0L) == -1) {
+        fprintf(stderr, "error: failed to ptrace detach: %s\n", strerror(errno));
+        return false;
+    }
+    return success;
+}
+
+
+bool subject_set_live(subject_t *subject, bool live) {
+    if (subject->stop_depth > 0) {
+        fprintf(stderr, "error: cannot change live mode while the subject is stopped\n");
+        return false;
+    }
+    subject->live = live;
+    return true;
+}
+
+
+// Kernels without CONFIG_MEM_SOFT_DIRTY accept clear_refs writes but never
+// report a dirty page. Fresh pages are always soft-dirty where supported, so
+// one page of our own tells them apart.
+static bool soft_dirty_supported(void) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    volatile uint8_t *page = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        return false;
+    }
+    page[0] = 1;
+
+    uint64_t entry = 0;
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd != -1) {
+        if (pread(fd, &entry, sizeof(entry), (off_t)((size_t)page / page_size * sizeof(uint64_t))) != sizeof(entry)) {
+            entry = 0;
+        }
+        close(fd);
+    }
+    munmap((void *)page, page_size);
+    return (entry & PAGEMAP_SOFT_DIRTY) != 0;
+}
+
+
+// Soft-dirty bits are per process, so they are cleared once at the end of
+// each stop for every scan synced during it: every clear starts a new epoch
+// and a scan is current while its epoch matches the subject's. Scans a
+// command passes over under one stop therefore all trust the bits next time.
+bool subject_set_dirty_tracking(subject_t *subject, bool enabled) {
+    if (!enabled) {
+        if (subject->clear_refs_fd != -1) {
+            close(subject->clear_refs_fd);
+        }
+        subject->clear_refs_fd = -1;
+        subject->dirty_tracking = false;
+        subject->dirty_clear_pending = false;
+        return true;
+    }
+    if (subject->dirty_tracking) {
+        return true;
+    }
+    if (!soft_dirty_supported()) {
+        fprintf(stderr, "error: kernel does not track soft-dirty pages\n");
+        return false;
+    }
+
+    char path[48] = {0};
+    snprintf(path, sizeof(path) - 1, "/proc/%d/clear_refs", subject->pid);
+    subject->clear_refs_fd = open(path, O_WRONLY);
+    if (subject->pagemap_fd == -1 || subject->clear_refs_fd == -1) {
+        fprintf(stderr, "error: failed to open pagemap or clear_refs: %s\n", strerror(errno));
+        subject_set_dirty_tracking(subject, false);
+        return false;
+    }
+
+    // Rejected by kernels built without soft-dirty support
+    if (pwrite(subject->clear_refs_fd, "4", 1, 0) != 1) {
+        fprintf(stderr, "error: failed to clear soft-dirty bits: %s\n", strerror(errno));
+        subject_set_dirty_tracking(subject, false);
+        return false;
+    }
+    subject->dirty_epoch++;
+    subject->dirty_tracking = true;
+    if (subject->stop_depth > 0 && !subject->live) {
+        freeze_pause(subject, true);
+    }
+    return true;
+}
+
+
+// The pagemap fd a pass over the scan can use to skip clean pages, or -1. A
+// first pass copies them from the snapshot, later passes take the values of
+// their hits from the last pass.
+static int scan_pagemap_fd(scan_t *scan) {
+    subject_t *subject = scan->subject;
+    if (!subject->dirty_tracking || subject->live || (scan->snapshot == NULL && !scan->searched)) {
+        return -1;
+    }
+    // Bits set since the last clear cover whatever changed since a scan
+    // was synced earlier in the current stop as well
+    bool synced_this_stop = subject->dirty_clear_pending && scan->dirty_epoch == subject->dirty_epoch + 1;
+    if (scan->dirty_epoch != subject->dirty_epoch && !synced_this_stop) {
+        return -1;
+    }
+    return subject->pagemap_fd;
+}
+
+
+// Called after every pass that left the scan's snapshot or the values of
+// its hits in sync with the subject's memory. Every pass runs under a stop,
+// the scan becomes current once subject_resume ends it.
+static bool scan_sync_dirty(scan_t *scan) {
+    subject_t *subject = scan->subject;
+    if (!subject->dirty_tracking || subject->live || (scan->snapshot == NULL && !scan->searched)) {
+        return true;
+    }
+    subject->dirty_clear_pending = true;
+    scan->dirty_epoch = subject->dirty_epoch + 1;
+    return true;
+}
+
+
+// Applies to the first pass of every later scan and snapshot of the subject,
+// narrowing passes only read their hits
+bool subject_set_region_policy(subject_t *subject, const region_policy_t *policy) {
+    char *module = NULL;
+    if (policy->module != NULL) {
+        module = strdup(policy->module);
+        if (module == NULL) {
+            fprintf(stderr, "error: out of memory while copying region policy\n");
+            return false;
+        }
+    }
+    free(subject->policy.module);
+    subject->policy = *policy;
+    subject->policy.module = module;
+    return true;
+}
+
+
+void subject_reset_stats(subject_t *subject) {
+    memset(&subject->stats, 0, sizeof(scan_stats_t));
+    for (scan_t *scan=subject->scans; scan != NULL; scan = scan->next) {
+        memset(&scan->stats, 0, sizeof(scan_stats_t));
+    }
+}
+
+
+void print_stats(const char *name, const scan_stats_t *stats) {
+    printf("%s:\n", name);
+    printf("  bytes read     %" PRIu64 "\n", stats->bytes_read);
+    printf("  bytes written  %" PRIu64 "\n", stats->bytes_written);
+    printf("  syscalls       %" PRIu64 "\n", stats->syscalls);
+    if (stats->stop_count > 0) {
+        printf("  stops          %" PRIu64 " (%.3f ms stopped)\n", stats->stop_count, (double)stats->stop_ns / 1e6);
+    }
+    if (stats->region_count > 0) {
+        printf("  regions        %" PRIu64 " (%.3f ms, slowest %.3f ms)\n", stats->region_count, (double)stats->region_ns / 1e6, (double)stats->region_max_ns / 1e6);
+    }
+    printf("  compare time   %.3f ms\n", (double)stats->compare_ns / 1e6);
+    printf("  hits           %" PRIu64 "\n", stats->hits);
+    printf("  reallocs       %" PRIu64 "\n", stats->reallocs);
+}
+
+
+scan_t *subject_begin_scan(subject_t *subject, scan_type_e type, size_t alignment) {
+    if (subject == NULL) {
+        return NULL;
+    }
+
+    scan_t *scan = malloc(sizeof(scan_t));
+    if (scan == NULL) {
+        fprintf(stderr, "error: out of memory while allocating scan\n");
+        return NULL;
+    }
+    scan->subject = (subject_t *)subject;
+    scan->type = type;
+    scan->alignment = (alignment == SCAN_ALIGN_NATURAL) ? scan_type_size(type) : alignment;
+    hit_set_init(&scan->hits);
+    value_column_init(&scan->values, scan_type_size(type));
+    scan->string = NULL;
+    scan->group = NULL;
+    scan->searched = false;
+    scan->snapshot = NULL;
+    scan->zones = NULL;
+    memset(&scan->stats, 0, sizeof(scan_stats_t));
+    scan->dirty_epoch = 0;
+
+    push_scan(scan);
+    return scan;
+}
+
+
+// Decodes the next code point of UTF-8 text, returning false for malformed
+// or overlong sequences and surrogates
+static bool utf8_decode(const uint8_t **cursor, uint32_t *code_point) {
+    const uint8_t *bytes = *cursor;
+    size_t length;
+    uint32_t minimum;
+    if (bytes[0] < 0x80) {
+        *code_point = bytes[0];
+        *cursor += 1;
+        return true;
+    } else if ((bytes[0] & 0xe0) == 0xc0) {
+        length = 2;
+        minimum = 0x80;
+        *code_point = bytes[0] & 0x1f;
+    } else if ((bytes[0] & 0xf0) == 0xe0) {
+        length = 3;
+        minimum = 0x800;
+        *code_point = bytes[0] & 0x0f;
+    } else if ((bytes[0] & 0xf8) == 0xf0) {
+        length = 4;
+        minimum = 0x10000;
+        *code_point = bytes[0] & 0x07;
+    } else {
+        return false;
+    }
+    for (size_t i=1; i < length; i++) {
+        if ((bytes[i] & 0xc0) != 0x80) {
+            return false;
+        }
+        *code_point = (*code_point << 6) | (bytes[i] & 0x3f);
+    }
+    *cursor += length;
+    return *code_point >= minimum && *code_point <= 0x10ffff && (*code_point < 0xd800 || *code_point > 0xdfff);
+}
+
+
+// Encodes UTF-8 text as the needle and marks the bytes that fold. Only
+// ASCII letters fold: every byte of a UTF-8 multibyte sequence is above
+// 0x7f and a UTF-16 unit only folds when its high byte is zero.
+static bool encode_string(scan_string_t *string, const char *text) {
+    size_t size = 0;
+    const uint8_t *cursor = (const uint8_t *)text;
+    while (*cursor != '\0') {
+        uint8_t units[4];
+        size_t unit_size;
+        if (string->encoding == STRING_UTF8) {
+            units[0] = *cursor++;
+            unit_size = 1;
+        } else {
+            uint32_t code_point;
+            if (!utf8_decode(&cursor, &code_point)) {
+                fprintf(stderr, "error: '%s' is not valid UTF-8\n", text);
+                return false;
+            }
+            if (code_point >= 0x10000) {
+                uint32_t high = 0xd800 + ((code_point - 0x10000) >> 10);
+                uint32_t low = 0xdc00 + ((code_point - 0x10000) & 0x3ff);
+                uint8_t pair[4] = {high & 0xff, high >> 8, low & 0xff, low >> 8};
+                memcpy(units, pair, sizeof(pair));
+                unit_size = 4;
+            } else {
+                units[0] = code_point & 0xff;
+                units[1] = code_point >> 8;
+                unit_size = 2;
+            }
+        }
+        if (size + unit_size > SCAN_STRING_MAX) {
+            fprintf(stderr, "error: '%s' is longer than %d bytes encoded\n", text, SCAN_STRING_MAX);
+            return false;
+        }
+        for (size_t i=0; i < unit_size; i++) {
+            uint8_t byte = units[i];
+            bool letter = (byte >= 'A' && byte <= 'Z') || (byte >= 'a' && byte <= 'z');
+            bool folds = string->ignore_case && letter && (string->encoding == STRING_UTF8 || (i % 2 == 0 && units[i + 1] == 0));
+            string->fold[size] = folds ? 0x20 : 0;
+            string->bytes[size] = byte | string->fold[size];
+            size++;
+        }
+    }
+    string->size = size;
+    return true;
+}
+
+
+// Starts a scan for the text, given as UTF-8, in the encoding. Case
+// folding only applies to ASCII letters. A string scan only supports
+// equal searches, a first pass finds the string and later passes keep the
+// hits that still hold it.
+scan_t *subject_begin_string_scan(subject_t *subject, const char *text, string_encoding_e encoding, bool ignore_case) {
+    if (subject == NULL) {
+        return NULL;
+    }
+    if (text[0] == '\0') {
+        fprintf(stderr, "error: cannot search for an empty string\n");
+        return NULL;
+    }
+
+    scan_string_t *string = calloc(1, sizeof(scan_string_t));
+    if (string == NULL) {
+        fprintf(stderr, "error: out of memory while allocating string scan\n");
+        return NULL;
+    }
+    string->encoding = encoding;
+    string->ignore_case = ignore_case;
+    if (!encode_string(string, text)) {
+        free(string);
+        return NULL;
+    }
+
+    scan_t *scan = subject_begin_scan(subject, SCANTYPE_STRING, SCAN_ALIGN_BYTE);
+    if (scan == NULL) {
+        free(string);
+        return NULL;
+    }
+    value_column_init(&scan->values, string->size);
+    scan->string = string;
+    return scan;
+}
+
+
+// Rough guess of how few values a field matches, higher is fewer. Equal
+// searches for wide, non-zero values rule out the most bases; zero fills
+// much of memory and ranges rule out the least.
+static size_t field_selectivity(const scan_field_t *field) {
+    size_t size = scan_type_size(field->type);
+    scan_value_u zero = {0};
+    switch (field->op)
+    {
+        case SEARCH_EQUAL:
+            return (memcmp(&field->value, &zero, size) != 0) ? 32 + size : 16;
+        case SEARCH_APPROX:
+            return 8 + size;
+        default:
+            return 1;
+    }
+}
+
+
+scan_t *subject_begin_group_scan(subject_t *subject, const scan_field_t *fields, size_t field_count, size_t alignment) {
+    if (subject == NULL) {
+        return NULL;
+    }
+    if (field_count == 0 || field_count > SCAN_GROUP_MAX_FIELDS) {
+        fprintf(stderr, "error: a group needs 1 to %d fields\n", SCAN_GROUP_MAX_FIELDS);
+        return NULL;
+    }
+
+    scan_group_t *group = calloc(1, sizeof(scan_group_t));
+    if (group == NULL) {
+        fprintf(stderr, "error: out of memory while allocating group scan\n");
+        return NULL;
+    }
+    size_t widest = 1;
+    for (size_t i=0; i < field_count; i++) {
+        const scan_field_t *field = &fields[i];
+        if (field->type > SCANTYPE_FLOAT64) {
+            fprintf(stderr, "error: group fields must hold numbers\n");
+            goto FAIL;
+        }
+        if (field->op != SEARCH_EQUAL && field->op != SEARCH_LESS && field->op != SEARCH_GREATER && field->op != SEARCH_APPROX) {
+            fprintf(stderr, "error: group fields only support equal, less, greater and approx searches\n");
+            goto FAIL;
+        }
+        size_t size = scan_type_size(field->type);
+        if (field->offset > SCAN_GROUP_MAX_SIZE - size) {
+            fprintf(stderr, "error: group fields must end within %d bytes of the base\n", SCAN_GROUP_MAX_SIZE);
+            goto FAIL;
+        }
+
+        // Insertion sort by selectivity, fields that tie keep their order
+        size_t j = group->field_count;
+        while (j > 0 && field_selectivity(&group->fields[j - 1]) < field_selectivity(field)) {
+            group->fields[j] = group->fields[j - 1];
+            j--;
+        }
+        group->fields[j] = *field;
+        group->field_count++;
+        group->size = MAX(group->size, field->offset + size);
+        widest = MAX(widest, size);
+    }
+
+    scan_t *scan = subject_begin_scan(subject, SCANTYPE_GROUP, (alignment == SCAN_ALIGN_NATURAL) ? widest : alignment);
+    if (scan == NULL) {
+        goto FAIL;
+    }
+    value_column_init(&scan->values, group->size);
+    scan->group = group;
+    return scan;
+
+  FAIL:
+    free(group);
+    return NULL;
+}
+
+
+void subject_free(subject_t *subject) {
+    if (subject == NULL) {
+        return;
+    }
+    if (subject->async != NULL) {
+        subject_cancel_scan(subject);
+        subject_wait_scan(subject);
+    }
+    if (subject->freeze_running) {
+        pthread_mutex_lock(&subject->freeze_lock);
+        subject->freeze_stopping = true;
+        pthread_cond_signal(&subject->freeze_wake);
+        pthread_mutex_unlock(&subject->freeze_lock);
+        pthread_join(subject->thread_id, NULL);
+    }
+    while (subject->scans != NULL) {
+        scan_free(subject->scans);
+    }
+    while (subject->stop_depth > 0) {
+        subject_resume(subject);
+    }
+    if (subject->memory_fd != -1) {
+        close(subject->memory_fd);
+    }
+    subject_set_dirty_tracking(subject, false);
+    if (subject->pagemap_fd != -1) {
+        close(subject->pagemap_fd);
+    }
+    free(subject->policy.module);
+    pthread_cond_destroy(&subject->freeze_wake);
+    pthread_mutex_destroy(&subject->freeze_lock);
+    free(subject);
+}
+
+
+static scan_value_u value_arg(scan_type_e type, va_list *args) {
+    scan_value_u value = {0};
+    switch (type)
+    {
+        case SCANTYPE_UINT8: value.uint8 = (uint8_t)va_arg(*args, unsigned); break;
+        case SCANTYPE_UINT16: value.uint16 = (uint16_t)va_arg(*args, unsigned); break;
+        case SCANTYPE_UINT32: value.uint32 = va_arg(*args, uint32_t); break;
+        case SCANTYPE_UINT64: value.uint64 = va_arg(*args, uint64_t); break;
+        case SCANTYPE_INT8: value.int8 = (int8_t)va_arg(*args, int); break;
+        case SCANTYPE_INT16: value.int16 = (int16_t)va_arg(*args, int); break;
+        case SCANTYPE_INT32: value.int32 = va_arg(*args, int32_t); break;
+        case SCANTYPE_INT64: value.int64 = va_arg(*args, int64_t); break;
+        case SCANTYPE_FLOAT32: value.float32 = (float)va_arg(*args, double); break;
+        case SCANTYPE_FLOAT64: value.float64 = va_arg(*args, double); break;
+        case SCANTYPE_STRING: break;
+        case SCANTYPE_GROUP: break;
+    }
+    return value;
+}
+
+
+scan_value_u scan_value_from_double(scan_type_e type, double number) {
+    scan_value_u value = {0};
+    switch (type)
+    {
+        case SCANTYPE_UINT8: value.uint8 = (uint8_t)number; break;
+        case SCANTYPE_UINT16: value.uint16 = (uint16_t)number; break;
+        case SCANTYPE_UINT32: value.uint32 = (uint32_t)number; break;
+        case SCANTYPE_UINT64: value.uint64 = (uint64_t)number; break;
+        case SCANTYPE_INT8: value.int8 = (int8_t)number; break;
+        case SCANTYPE_INT16: value.int16 = (int16_t)number; break;
+        case SCANTYPE_INT32: value.int32 = (int32_t)number; break;
+        case SCANTYPE_INT64: value.int64 = (int64_t)number; break;
+        case SCANTYPE_FLOAT32: value.float32 = (float)number; break;
+        case SCANTYPE_FLOAT64: value.float64 = number; break;
+        case SCANTYPE_STRING: break;
+        case SCANTYPE_GROUP: break;
+    }
+    return value;
+}
+
+
+scan_value_u scan_get_value(const scan_t *scan, size_t index) {
+    scan_value_u value = {0};
+    if (index < scan->values.count) {
+        memcpy(&value, value_column_get(&scan->values, index), MIN(scan->values.value_size, sizeof(value)));
+    }
+    return value;
+}
+
+
+size_t scan_type_size(scan_type_e type) {
+    switch (type)
+    {
+        case SCANTYPE_UINT8: return sizeof(uint8_t);
+        case SCANTYPE_UINT16: return sizeof(uint16_t);
+        case SCANTYPE_UINT32: return sizeof(uint32_t);
+        case SCANTYPE_UINT64: return sizeof(uint64_t);
+        case SCANTYPE_INT8: return sizeof(int8_t);
+        case SCANTYPE_INT16: return sizeof(int16_t);
+        case SCANTYPE_INT32: return sizeof(int32_t);
+        case SCANTYPE_INT64: return sizeof(int64_t);
+        case SCANTYPE_FLOAT32: return sizeof(float);
+        case SCANTYPE_FLOAT64: return sizeof(double);
+        // Taken from the needle of each string or group scan
+        case SCANTYPE_STRING: return 0;
+        case SCANTYPE_GROUP: return 0;
+    }
+    return 0;
+}
+
+
+// String and group scans hold needles that do not fit in a scan_value_u
+static bool scan_is_composite(const scan_t *scan) {
+    return scan->string != NULL || scan->group != NULL;
+}
+
+
+// Needle the kernels of the scan compare against
+static const void *scan_needle(const scan_t *scan, const scan_value_u *value) {
+    if (scan->string != NULL) {
+        return scan->string;
+    }
+    if (scan->group != NULL) {
+        return scan->group;
+    }
+    return value;
+}
+
+
+scan_t *scan_fork(scan_t *scan) {
+    scan_t *result = malloc(sizeof(scan_t));
+    memcpy(result, scan, sizeof(scan_t));
+    if (!hit_set_copy(&result->hits, &scan->hits)) {
+        free(result);
+        return NULL;
+    }
+    if (!value_column_copy(&result->values, &scan->values)) {
+        hit_set_clear(&result->hits);
+        free(result);
+        return NULL;
+    }
+    if (scan->string != NULL) {
+        result->string = malloc(sizeof(scan_string_t));
+        if (result->string == NULL) {
+            fprintf(stderr, "error: out of memory while copying string scan\n");
+            hit_set_clear(&result->hits);
+            value_column_clear(&result->values);
+            free(result);
+            return NULL;
+        }
+        memcpy(result->string, scan->string, sizeof(scan_string_t));
+    }
+    if (scan->group != NULL) {
+        result->group = malloc(sizeof(scan_group_t));
+        if (result->group == NULL) {
+            fprintf(stderr, "error: out of memory while copying group scan\n");
+            free(result->string);
+            hit_set_clear(&result->hits);
+            value_column_clear(&result->values);
+            free(result);
+            return NULL;
+        }
+        memcpy(result->group, scan->group, sizeof(scan_group_t));
+    }
+    // The copy shares the snapshot, its index is still usable without the
+    // zone map, so a failure here only drops that
+    if (result->snapshot != NULL) {
+        result->snapshot->refs++;
+    }
+    if (scan->zones != NULL) {
+        result->zones = malloc(scan->snapshot->zone_count * sizeof(zone_t));
+        if (result->zones != NULL) {
+            memcpy(result->zones, scan->zones, scan->snapshot->zone_count * sizeof(zone_t));
+        }
+    }
+    push_scan(result);
+    return result;
+}
+
+
+bool scan_refresh(scan_t *scan) {
+    bool success = false;
+    subject_t *subject = scan->subject;
+
+    if (!subject_stop(subject)) {
+        return false;
+    }
+
+    if (!memory_filter(scan, subject->memory_fd, scan_pagemap_fd(scan), NULL, scan->values.value_size, SEARCH_NOOP)) {
+        goto EXIT;
+    }
+
+    success = scan_sync_dirty(scan);
+
+  EXIT:
+    if (!subject_resume(subject)) {
+        success = false;
+    }
+
+    return success;
+}
+
+
+void scan_eliminate(scan_t *scan, size_t index) {
+    if (index >= scan->hits.count) {
+        return;
+    }
+
+    hit_set_remove(&scan->hits, index);
+    value_column_remove(&scan->values, index);
+}
+
+
+// Takes one snapshot for all the scans, which start over from it. The data
+// is shared, the scans only hold a reference to it.
+bool subject_snapshot_scans(subject_t *subject, scan_t **scans, size_t scan_count) {
+    bool success = false;
+    maps_t *maps = NULL;
+    snapshot_t *snapshot = NULL;
+
+    for (size_t i=0; i < scan_count; i++) {
+        if (scan_is_composite(scans[i])) {
+            fprintf(stderr, "error: string and group scans do not take snapshots\n");
+            return false;
+        }
+    }
+
+    if (!subject_stop(subject)) {
+        return false;
+    }
+
+    maps = read_maps(subject->pid);
+    if (maps == NULL) {
+        goto EXIT;
+    }
+
+    snapshot = create_snapshot(maps, &subject->policy);
+    if (snapshot == NULL) {
+        goto EXIT;
+    }
+
+    scan_stats_t stats = {0};
+    bool captured = snapshot_capture(snapshot, subject->memory_fd, subject->worker_count, &stats);
+    stats_add(&subject->stats, &stats);
+    if (!captured) {
+        goto EXIT;
+    }
+
+    for (size_t i=0; i < scan_count; i++) {
+        scan_t *scan = scans[i];
+        stats_add(&scan->stats, &stats);
+        release_snapshot(scan->snapshot);
+        free(scan->zones);
+        scan->zones = NULL;
+        hit_set_clear(&scan->hits);
+        value_column_clear(&scan->values);
+        scan->searched = false;
+        scan->snapshot = snapshot;
+        snapshot->refs++;
+        scan_sync_dirty(scan);
+    }
+    success = true;
+
+  EXIT:
+    if (!subject_resume(subject)) {
+        success = false;
+    }
+    if (snapshot != NULL && snapshot->refs == 0) {
+        free_snapshot(snapshot);
+    }
+    free_maps(maps);
+
+    return success;
+}
+
+
+bool scan_snapshot(scan_t *scan) {
+    return subject_snapshot_scans(scan->subject, &scan, 1);
+}
+
+
+// Summarizes every zone of the scan's snapshot by the smallest and largest
+// value of the scan's type that starts in it, so scan_query can skip the
+// zones that cannot hold a match. Passes over a searched scan only keep its
+// snapshot current at the hits, so only a scan that was not searched since
+// its snapshot was taken can be indexed.
+bool scan_build_index(scan_t *scan) {
+    snapshot_t *snapshot = scan->snapshot;
+    if (snapshot == NULL) {
+        fprintf(stderr, "error: scan has no snapshot to index\n");
+        return false;
+    }
+    if (scan->searched) {
+        fprintf(stderr, "error: scan was searched since its snapshot was taken, take a new snapshot to index it\n");
+        return false;
+    }
+
+    zone_t *zones = calloc(MAX(snapshot->zone_count, 1), sizeof(zone_t));
+    if (zones == NULL) {
+        fprintf(stderr, "error: out of memory while allocating snapshot index\n");
+        return false;
+    }
+    free(scan->zones);
+    scan->zones = zones;
+
+    uint64_t start = clock_ns();
+    for (size_t i=0; i < snapshot->region_count; i++) {
+        const snapshot_region_t *region = &snapshot->regions[i];
+        zone_update(scan, region, 0, region_zone_count(region));
+    }
+    scan_stats_t stats = {0};
+    stats.compare_ns = clock_ns() - start;
+    record_stats(scan, &stats);
+    return true;
+}
+
+
+// Recomputes the zones of every scan indexing the snapshot that hold values
+// overlapping [position, end) of region
+static void update_indexes(subject_t *subject, snapshot_t *snapshot, const snapshot_region_t *region, size_t position, size_t end) {
+    for (scan_t *scan=subject->scans; scan != NULL; scan = scan->next) {
+        if (scan->snapshot != snapshot || scan->zones == NULL) {
+            continue;
+        }
+        // Values that start in the zone before the range can end in it
+        size_t from = MAX(position - MIN(position, scan->values.value_size - 1), region->offset);
+        zone_update(scan, region, (from - region->offset) / SNAPSHOT_ZONE_SIZE, (end - region->offset - 1) / SNAPSHOT_ZONE_SIZE + 1);
+    }
+}
+
+
+// Reads the pages written since the snapshot was last synced into it and
+// recomputes the zones holding values that overlap them. Pages of anonymous
+// regions that were dropped since are zeroed, other pages that are no longer
+// present are read again, which fails the refresh when they were unmapped.
+static bool index_read_dirty(subject_t *subject, snapshot_t *snapshot, int pagemap_fd, scan_stats_t *stats) {
+    pagemap_t pagemap;
+    pagemap_init(&pagemap, pagemap_fd);
+
+    for (size_t i=0; i < snapshot->region_count; i++) {
+        const snapshot_region_t *region = &snapshot->regions[i];
+        size_t region_end = region->offset + region->size;
+        size_t position = region->offset;
+        while (position < region_end) {
+            page_source_e source = page_source(&pagemap, position, region->anonymous, true, stats);
+            if (source == PAGE_SNAPSHOT) {
+                position += pagemap.page_size;
+                continue;
+            }
+            size_t run_end = position + pagemap.page_size;
+            while (run_end < region_end && page_source(&pagemap, run_end, region->anonymous, true, stats) == source) {
+                run_end += pagemap.page_size;
+            }
+            run_end = MIN(run_end, region_end);
+
+            if (source == PAGE_ZERO) {
+                memset(region->data + (position - region->offset), 0, run_end - position);
+                update_indexes(subject, snapshot, region, position, run_end);
+                position = run_end;
+                continue;
+            }
+
+            size_t bytes_read = 0;
+            while (position + bytes_read < run_end) {
+                ssize_t read_result = pread(subject->memory_fd, region->data + (position - region->offset) + bytes_read, run_end - position - bytes_read, (off_t)(position + bytes_read));
+                stats->syscalls++;
+                if (read_result <= 0) {
+                    fprintf(stderr, "error: failed to read memory at 0x%zx into snapshot\n", position + bytes_read);
+                    return false;
+                }
+                bytes_read += (size_t)read_result;
+            }
+            stats->bytes_read += bytes_read;
+
+            update_indexes(subject, snapshot, region, position, run_end);
+            position = run_end;
+        }
+    }
+    return true;
+}
+
+
+// Brings the snapshot and its index up to date with the subject. With
+// soft-dirty tracking only the pages written since the last sync are read
+// and their zones recomputed, otherwise the snapshot is captured again in
+// full. The snapshot is shared, so every scan holding it compares later
+// relative searches against the refreshed copy and has its index
+// refreshed as well.
+bool scan_refresh_index(scan_t *scan) {
+    bool success = false;
+    subject_t *subject = scan->subject;
+    snapshot_t *snapshot = scan->snapshot;
+    if (snapshot == NULL || scan->zones == NULL) {
+        fprintf(stderr, "error: scan has no index to refresh\n");
+        return false;
+    }
+
+    if (!subject_stop(subject)) {
+        return false;
+    }
+
+    scan_stats_t stats = {0};
+    int pagemap_fd = scan_pagemap_fd(scan);
+    bool refreshed;
+    if (pagemap_fd != -1) {
+        refreshed = index_read_dirty(subject, snapshot, pagemap_fd, &stats);
+    } else {
+        refreshed = snapshot_capture(snapshot, subject->memory_fd, subject->worker_count, &stats);
+        for (size_t i=0; refreshed && i < snapshot->region_count; i++) {
+            const snapshot_region_t *region = &snapshot->regions[i];
+            update_indexes(subject, snapshot, region, region->offset, region->offset + region->size);
+        }
+    }
+    record_stats(scan, &stats);
+
+    for (scan_t *sharer=subject->scans; sharer != NULL; sharer = sharer->next) {
+        if (sharer->snapshot != snapshot) {
+            continue;
+        }
+        if (!refreshed) {
+            free(sharer->zones);
+            sharer->zones = NULL;
+            continue;
+        }
+        scan_sync_dirty(sharer);
+    }
+    success = refreshed;
+
+    if (!subject_resume(subject)) {
+        success = false;
+    }
+
+    return success;
+}
+
+
+// Answers a first pass from the scan's indexed snapshot without reading the
+// subject: the result is a new, already searched scan of every position
+// whose snapshot value passes all op_count ops, each with its value.
+// Supports SEARCH_EQUAL, SEARCH_LESS, SEARCH_GREATER and SEARCH_APPROX, a
+// bounded search is SEARCH_GREATER and SEARCH_LESS. Zones whose bounds
+// rule out a match are skipped without looking at their values.
+scan_t *scan_query(scan_t *scan, const search_op_e *ops, const scan_value_u *values, size_t op_count) {
+    snapshot_t *snapshot = scan->snapshot;
+    if (snapshot == NULL || scan->zones == NULL) {
+        fprintf(stderr, "error: scan has no index to query\n");
+        return NULL;
+    }
+    if (op_count == 0) {
+        fprintf(stderr, "error: a query needs at least one search\n");
+        return NULL;
+    }
+    compare_kernel_t compares[SEARCH_APPROX + 1];
+    for (search_op_e op=SEARCH_NOOP; op <= SEARCH_APPROX; op++) {
+        compares[op] = kernel_select(scan->type, op, 1).compare;
+    }
+    for (size_t i=0; i < op_count; i++) {
+        if (ops[i] != SEARCH_EQUAL && ops[i] != SEARCH_LESS && ops[i] != SEARCH_GREATER && ops[i] != SEARCH_APPROX) {
+            fprintf(stderr, "error: indexes only answer equal, less, greater and approx searches\n");
+            return NULL;
+        }
+    }
+    mask_kernel_t *masks = malloc(op_count * sizeof(mask_kernel_t));
+    if (masks == NULL) {
+        fprintf(stderr, "error: out of memory while preparing query\n");
+        return NULL;
+    }
+    for (size_t i=0; i < op_count; i++) {
+        masks[i] = kernel_select(scan->type, ops[i], scan->alignment).mask;
+    }
+
+    scan_t *result = subject_begin_scan(scan->subject, scan->type, scan->alignment);
+    if (result == NULL) {
         goto EXIT;
     }
+    result->searched = true;
+
+    uint64_t mask[SNAPSHOT_ZONE_SIZE / 64];
+    uint64_t op_mask[SNAPSHOT_ZONE_SIZE / 64];
+    scan_stats_t stats = {0};
+    uint64_t start = clock_ns();
+    size_t value_size = scan->values.value_size;
+    for (size_t i=0; i < snapshot->region_count; i++) {
+        const snapshot_region_t *region = &snapshot->regions[i];
+        size_t zone_count = region_zone_count(region);
+        for (size_t zone=0; zone < zone_count; zone++) {
+            const zone_t *bounds = &scan->zones[region->first_zone + zone];
+            size_t first;
+            size_t count = zone_positions(region, zone, value_size, scan->alignment, &first);
+            bool skip = (count == 0);
+            for (size_t j=0; j < op_count && !skip; j++) {
+                skip = !zone_may_match(bounds, compares, ops[j], &values[j]);
+            }
+            if (skip) {
+                continue;
+            }
+
+            const uint8_t *buffer = region->data + (first - region->offset);
+            size_t words = kernel_mask_words(count);
+            masks[0](buffer, count, scan->alignment, &values[0], mask);
+            for (size_t j=1; j < op_count; j++) {
+                masks[j](buffer, count, scan->alignment, &values[j], op_mask);
+                for (size_t word=0; word < words; word++) {
+                    mask[word] &= op_mask[word];
+                }
+            }
+            for (size_t word=0; word < words; word++) {
+                uint64_t bits = mask[word];
+                while (bits != 0) {
+                    size_t index = word * 64 + (size_t)__builtin_ctzll(bits);
+                    const uint8_t *value = buffer + index * scan->alignment;
+                    if (!value_column_append(&result->values, value) || !hit_set_append(&result->hits, first + index * scan->alignment)) {
+                        fprintf(stderr, "error: out of memory while storing query hits\n");
+                        scan_free(result);
+                        result = NULL;
+                        goto EXIT;
+                    }
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+    stats.compare_ns = clock_ns() - start;
+    stats.hits = result->hits.count;
+    record_stats(result, &stats);
+
+  EXIT:
+    free(masks);
+    return result;
+}
+
+
+static void init_lane(scan_lane_t *lane, scan_t *scan, search_op_e op, const scan_value_u *value) {
+    lane->scan = scan;
+    lane->op = op;
+    lane->needle = *value;
+    lane->kernel_needle = scan_needle(scan, &lane->needle);
+    lane->needle_bytes = NULL;
+    if (scan->string != NULL && !scan->string->ignore_case) {
+        lane->needle_bytes = scan->string->bytes;
+    } else if (scan->string == NULL && scan->group == NULL && scan->type != SCANTYPE_FLOAT32 && scan->type != SCANTYPE_FLOAT64) {
+        // Equal floats are not always equal bytes, -0.0 == 0.0 and NaN != NaN
+        lane->needle_bytes = (const uint8_t *)&lane->needle;
+    }
+    lane->needle_size = scan->values.value_size;
+    lane->alignment = scan->alignment;
+    lane->kernel = kernel_select(scan->type, op, scan->alignment);
+
+    static const uint8_t zero[SCAN_CARRY_ROOM] = {0};
+    lane->zero_matches = search_op_is_relative(op) || lane->kernel.compare(zero, lane->kernel_needle);
+}
+
+
+static bool scan_supports_op(scan_t *scan, search_op_e op) {
+    if (kernel_select(scan->type, op, scan->alignment).compare == NULL) {
+        fprintf(stderr, "error: string and group scans only support equal searches\n");
+        return false;
+    }
+    return true;
+}
+
+
+// First pass of one or more scans over the same memory. With a snapshot the
+// snapshot regions are searched, which every lane has to share.
+static bool search_lanes(subject_t *subject, scan_lane_t *lanes, size_t lane_count, snapshot_t *snapshot) {
+    size_t job_count;
+    scan_job_t *jobs;
+    if (snapshot != NULL) {
+        jobs = split_snapshot(snapshot, &job_count);
+    } else {
+        maps_t *maps = read_maps(subject->pid);
+        if (maps == NULL) {
+            return false;
+        }
+        jobs = split_scan_regions(maps, &subject->policy, &job_count);
+        free_maps(maps);
+    }
+    if (jobs == NULL) {
+        return false;
+    }
 
-    if (scan->hits == NULL) {
-        maps_t *maps = read_maps(pid);
-        if (maps == NULL) {
+    bool use_snapshot = (snapshot != NULL && scan_pagemap_fd(lanes[0].scan) != -1);
+    bool success = memory_search_jobs(subject, lanes, lane_count, jobs, job_count, use_snapshot);
+    free(jobs);
+
+    // The pass leaves the snapshot as it was, and later passes only compare
+    // against the values of the hits
+    for (size_t i=0; success && snapshot != NULL && i < lane_count; i++) {
+        scan_t *scan = lanes[i].scan;
+        release_snapshot(scan->snapshot);
+        scan->snapshot = NULL;
+        free(scan->zones);
+        scan->zones = NULL;
+    }
+    return success;
+}
+
+
+static bool scan_apply(scan_t *scan, search_op_e op, const scan_value_u *value) {
+    bool success = false;
+    subject_t *subject = scan->subject;
+
+    if (search_op_is_relative(op) && !scan->searched && scan->snapshot == NULL) {
+        fprintf(stderr, "error: relative search requires a snapshot or a previous search\n");
+        return false;
+    }
+    if (!scan_supports_op(scan, op)) {
+        return false;
+    }
+
+    if (!subject_stop(subject)) {
+        return false;
+    }
+
+    if (!scan->searched) {
+        scan_lane_t lane;
+        init_lane(&lane, scan, op, value);
+        if (!search_lanes(subject, &lane, 1, scan->snapshot)) {
             goto EXIT;
         }
-
-        scan->hit_capacity = 65536;
-        scan->hits = malloc(scan->hit_capacity * sizeof(size_t));
-        if (scan->hits == NULL) {
-            fprintf(stderr, "error: failed to allocate 512KB: %s\n", strerror(errno));
-            free_maps(maps);
+    } else {
+        if (!memory_filter(scan, subject->memory_fd, scan_pagemap_fd(scan), scan_needle(scan, value), scan->values.value_size, op)) {
             goto EXIT;
         }
-        scan->hit_count = 0;
-        for (size_t i=0; i < maps->region_count; i++) {
-            region_t *region = &maps->regions[i];
-            if (!region->read || !region->write) {
-                continue;
-            }
-            if (!memory_search(scan, memory_fd, region->offset, region->size, &value, scan_type_size(scan->type), op)) {
-                free_maps(maps);
+    }
+
+    success = scan_sync_dirty(scan);
+
+  EXIT:
+    if (!subject_resume(subject)) {
+        success = false;
+    }
+
+    return success;
+}
+
+
+bool subject_update_scans(subject_t *subject, scan_t **scans, const scan_value_u *values, size_t scan_count, search_op_e op) {
+    bool success = false;
+
+    for (size_t i=0; i < scan_count; i++) {
+        if (!scan_supports_op(scans[i], op)) {
+            return false;
+        }
+    }
+
+    scan_lane_t *lanes = calloc(MAX(scan_count, 1), sizeof(scan_lane_t));
+    if (lanes == NULL) {
+        fprintf(stderr, "error: out of memory while allocating scan lanes\n");
+        return false;
+    }
+
+    if (!subject_stop(subject)) {
+        free(lanes);
+        return false;
+    }
+
+    // Scans still on their first pass over live memory share one read of
+    // every region, as do those on their first pass over one snapshot. The
+    // rest are narrowed one at a time.
+    size_t lane_count = 0;
+    for (size_t i=0; i < scan_count; i++) {
+        if (!scans[i]->searched && scans[i]->snapshot == NULL && !search_op_is_relative(op)) {
+            init_lane(&lanes[lane_count++], scans[i], op, &values[i]);
+        } else if (scans[i]->searched || scans[i]->snapshot == NULL) {
+            if (!scan_apply(scans[i], op, &values[i])) {
                 goto EXIT;
             }
         }
+    }
+    if (lane_count > 0 && !search_lanes(subject, lanes, lane_count, NULL)) {
+        goto EXIT;
+    }
 
-        free_maps(maps);
-    } else {
-        if (!memory_filter(scan, memory_fd, &value, scan_type_size(scan->type), op)) {
+    for (size_t i=0; i < scan_count; i++) {
+        snapshot_t *snapshot = scans[i]->snapshot;
+        if (scans[i]->searched || snapshot == NULL) {
+            continue;
+        }
+        lane_count = 0;
+        for (size_t j=i; j < scan_count; j++) {
+            if (!scans[j]->searched && scans[j]->snapshot == snapshot) {
+                init_lane(&lanes[lane_count++], scans[j], op, &values[j]);
+            }
+        }
+        if (!search_lanes(subject, lanes, lane_count, snapshot)) {
             goto EXIT;
         }
     }
@@ -513,102 +2458,532 @@ bool scan_update(scan_t *scan, search_op_e op, ...) {
     success = true;
 
   EXIT:
-    if (attached) {
-        if (ptrace(PTRACE_DETACH, pid, 0L, 0L) == -1) {
-            fprintf(stderr, "error: failed to ptrace detach: %s\n", strerror(errno));
-            return false;
-        }
-    }
-    if (memory_fd != -1) {
-        close(memory_fd);
+    if (!subject_resume(subject)) {
+        success = false;
     }
+    free(lanes);
 
     return success;
 }
 
 
-bool scan_set_value(scan_t *scan, ...) {
-    int memory_fd = -1;
+// Searches the subject for every pattern of the set in one pass over its
+// memory and fills hits[i] with the addresses of pattern i in ascending
+// order. Signatures are mostly looked for in code, so unlike value scans
+// read only regions are searched as well.
+bool subject_find_patterns(subject_t *subject, const pattern_set_t *set, hit_set_t *hits) {
     bool success = false;
-    bool attached = false;
-    subject_t *subject = scan->subject;
-    pid_t pid = subject->pid;
+    size_t job_count = 0;
+    scan_job_t *jobs = NULL;
+    scan_result_t *results = NULL;
 
-    scan_value_u value;
-    va_list args;
-    va_start(args, scan);
+    region_policy_t policy = subject->policy;
+    policy.writable = false;
 
-    switch (scan->type)
-    {
-        case SCANTYPE_UINT8: value.uint8 = (uint8_t)va_arg(args, unsigned); break;
-        case SCANTYPE_UINT16: value.uint16 = (uint16_t)va_arg(args, unsigned); break;
-        case SCANTYPE_UINT32: value.uint32 = va_arg(args, uint32_t); break;
-        case SCANTYPE_UINT64: value.uint64 = va_arg(args, uint64_t); break;
-        case SCANTYPE_INT8: value.int8 = (int8_t)va_arg(args, int); break;
-        case SCANTYPE_INT16: value.int16 = (int16_t)va_arg(args, int); break;
-        case SCANTYPE_INT32: value.int32 = va_arg(args, int32_t); break;
-        case SCANTYPE_INT64: value.int64 = va_arg(args, int64_t); break;
-        case SCANTYPE_FLOAT32: value.float32 = (float)va_arg(args, double); break;
-        case SCANTYPE_FLOAT64: value.float64 = va_arg(args, double); break;
+    if (!subject_stop(subject)) {
+        return false;
     }
 
-    va_end(args);
-
-    if (ptrace(PTRACE_ATTACH, pid, 0L, 0L) == -1) {
-        fprintf(stderr, "error: failed to ptrace attach: %s\n", strerror(errno));
+    maps_t *maps = read_maps(subject->pid);
+    if (maps == NULL) {
+        goto EXIT;
+    }
+    jobs = split_scan_regions(maps, &policy, &job_count);
+    free_maps(maps);
+    if (jobs == NULL) {
         goto EXIT;
     }
-    attached = true;
 
-    int status;
-    if (waitpid(pid, &status, 0) == -1) {
-        fprintf(stderr, "error: failed to waitpid: %s\n", strerror(errno));
+    results = calloc(MAX(job_count * set->count, 1), sizeof(scan_result_t));
+    if (results == NULL) {
+        fprintf(stderr, "error: out of memory while allocating pattern search\n");
         goto EXIT;
     }
+    for (size_t i=0; i < job_count; i++) {
+        jobs[i].results = results + i * set->count;
+    }
 
-    memory_fd = memory_open(pid);
-    if (memory_fd == -1) {
-        fprintf(stderr, "error: failed to open /proc/<pid>/mem: %s\n", strerror(errno));
+    scan_pool_t pool = {
+        .run = pattern_search,
+        .fd = subject->memory_fd,
+        .patterns = set,
+        .carry_size = set->max_size - 1,
+        .pagemap_fd = subject->pagemap_fd,
+        .jobs = jobs,
+        .job_count = job_count,
+    };
+    if (!pool_run(&pool, NULL, subject->worker_count)) {
         goto EXIT;
     }
 
-    size_t value_size = scan_type_size(scan->type);
-    for (size_t i=0; i < scan->hit_count; i++) {
-        size_t hit = scan->hits[i];
-        lseek(memory_fd, hit, SEEK_SET);
-        write(memory_fd, &value, value_size);
+    scan_stats_t job_stats = {0};
+    for (size_t i=0; i < job_count; i++) {
+        stats_add(&job_stats, &jobs[i].stats);
     }
+    for (size_t i=0; i < set->count; i++) {
+        hit_set_clear(&hits[i]);
+        for (size_t j=0; j < job_count; j++) {
+            if (!hit_set_concat(&hits[i], &jobs[j].results[i].hits)) {
+                goto EXIT;
+            }
+        }
+        job_stats.hits += hits[i].count;
+    }
+    stats_add(&subject->stats, &job_stats);
 
     success = true;
 
   EXIT:
-    if (attached) {
-        if (ptrace(PTRACE_DETACH, pid, 0L, 0L) == -1) {
-            fprintf(stderr, "error: failed to ptrace detach: %s\n", strerror(errno));
-            return false;
+    if (results != NULL) {
+        for (size_t i=0; i < job_count * set->count; i++) {
+            hit_set_clear(&results[i].hits);
+        }
+    }
+    free(results);
+    free(jobs);
+    if (!subject_resume(subject)) {
+        success = false;
+    }
+    return success;
+}
+
+
+static void free_async(async_scan_t *async) {
+    pthread_mutex_destroy(&async->callback_lock);
+    free(async->scans);
+    free(async->values);
+    free(async);
+}
+
+
+static void *async_main(void *arg) {
+    subject_t *subject = arg;
+    async_scan_t *async = subject->async;
+    async->success = subject_update_scans(subject, async->scans, async->values, async->scan_count, async->op);
+    atomic_store(&async->finished, true);
+    return NULL;
+}
+
+
+// Runs subject_update_scans on a background thread. Until subject_wait_scan
+// collects it, the subject and its scans may only be passed to
+// subject_scan_progress and subject_cancel_scan. The thread stops the
+// subject itself, so the subject must not be stopped by the caller.
+bool subject_update_scans_async(subject_t *subject, scan_t **scans, const scan_value_u *values, size_t scan_count, search_op_e op, scan_hits_callback_t callback, void *context) {
+    if (subject->async != NULL) {
+        fprintf(stderr, "error: a background scan is already running\n");
+        return false;
+    }
+    if (subject->stop_depth > 0) {
+        fprintf(stderr, "error: cannot start a background scan while the subject is stopped\n");
+        return false;
+    }
+
+    async_scan_t *async = calloc(1, sizeof(async_scan_t));
+    if (async != NULL) {
+        async->scans = malloc(MAX(scan_count, 1) * sizeof(scan_t *));
+        async->values = malloc(MAX(scan_count, 1) * sizeof(scan_value_u));
+    }
+    if (async == NULL || async->scans == NULL || async->values == NULL) {
+        fprintf(stderr, "error: out of memory while starting background scan\n");
+        if (async != NULL) {
+            free(async->scans);
+            free(async->values);
+        }
+        free(async);
+        return false;
+    }
+    memcpy(async->scans, scans, scan_count * sizeof(scan_t *));
+    memcpy(async->values, values, scan_count * sizeof(scan_value_u));
+    async->scan_count = scan_count;
+    async->op = op;
+    async->callback = callback;
+    async->context = context;
+    pthread_mutex_init(&async->callback_lock, NULL);
+    atomic_init(&async->bytes_done, 0);
+    atomic_init(&async->bytes_total, 0);
+    atomic_init(&async->regions_done, 0);
+    atomic_init(&async->region_count, 0);
+    atomic_init(&async->hits, 0);
+    atomic_init(&async->cancelled, false);
+    atomic_init(&async->finished, false);
+
+    subject->async = async;
+    int error = pthread_create(&async->thread, NULL, async_main, subject);
+    if (error != 0) {
+        fprintf(stderr, "error: failed to start background scan: %s\n", strerror(error));
+        subject->async = NULL;
+        free_async(async);
+        return false;
+    }
+    return true;
+}
+
+
+// Fills progress for the background scan. Returns false when there is no
+// scan left to collect.
+bool subject_scan_progress(subject_t *subject, scan_progress_t *progress) {
+    async_scan_t *async = subject->async;
+    if (async == NULL) {
+        return false;
+    }
+    progress->bytes_done = atomic_load(&async->bytes_done);
+    progress->bytes_total = atomic_load(&async->bytes_total);
+    progress->regions_done = atomic_load(&async->regions_done);
+    progress->region_count = atomic_load(&async->region_count);
+    progress->hits = atomic_load(&async->hits);
+    progress->running = !atomic_load(&async->finished);
+    progress->cancelled = atomic_load(&async->cancelled);
+    return true;
+}
+
+
+// Asks the background scan to stop at the next chunk or filter batch. Scans
+// whose pass did not complete keep the hits they had before it.
+void subject_cancel_scan(subject_t *subject) {
+    if (subject->async != NULL) {
+        atomic_store(&subject->async->cancelled, true);
+    }
+}
+
+
+// Waits for the background scan to finish. Returns false if it failed or was
+// cancelled.
+bool subject_wait_scan(subject_t *subject) {
+    async_scan_t *async = subject->async;
+    if (async == NULL) {
+        return false;
+    }
+    pthread_join(async->thread, NULL);
+    bool success = async->success && !atomic_load(&async->cancelled);
+    subject->async = NULL;
+    free_async(async);
+    return success;
+}
+
+
+bool scan_update(scan_t *scan, search_op_e op, ...) {
+    scan_value_u value = {0};
+    va_list args;
+    va_start(args, op);
+
+    if (!search_op_is_relative(op)) {
+        value = value_arg(scan->type, &args);
+    }
+
+    va_end(args);
+
+    return scan_apply(scan, op, &value);
+}
+
+
+bool scan_set_value(scan_t *scan, ...) {
+    subject_t *subject = scan->subject;
+    if (scan_is_composite(scan)) {
+        fprintf(stderr, "error: string and group scans cannot set values\n");
+        return false;
+    }
+
+    va_list args;
+    va_start(args, scan);
+    scan_value_u value = value_arg(scan->type, &args);
+    va_end(args);
+
+    if (!subject_stop(subject)) {
+        return false;
+    }
+    // The writes below must show up as dirty to scans synced in this stop
+    if (!subject_clear_dirty(subject)) {
+        subject_resume(subject);
+        return false;
+    }
+
+    size_t value_size = scan_type_size(scan->type);
+    scan_stats_t stats = {0};
+    size_t failed = 0;
+    struct iovec remote[WRITE_BATCH_SPANS];
+    size_t span_count = 0;
+    hit_iter_t iter;
+    size_t hit;
+    hit_iter_start(&iter, &scan->hits);
+    while (true) {
+        bool more = hit_iter_next(&iter, &hit);
+        if (more) {
+            remote[span_count].iov_base = (void *)hit;
+            remote[span_count].iov_len = value_size;
+            span_count++;
+        }
+        if (span_count == WRITE_BATCH_SPANS || (!more && span_count > 0)) {
+            failed += memory_write_spans(subject->pid, subject->memory_fd, &value, value_size, remote, span_count, &stats);
+            span_count = 0;
+        }
+        if (!more) {
+            break;
+        }
+    }
+    record_stats(scan, &stats);
+
+    if (failed > 0) {
+        fprintf(stderr, "error: failed to write %zu of %zu hits\n", failed, scan->hits.count);
+    }
+    return subject_resume(subject) && failed == 0;
+}
+
+
+static void free_freeze(freeze_t *freeze) {
+    if (freeze != NULL) {
+        free(freeze->remote);
+        free(freeze);
+    }
+}
+
+
+// Rewrites every frozen value once per interval until the subject is freed.
+// The lock is held while writing, so changing the freeze list waits for at
+// most one tick. Its writes stay out of the subject's stats, which are only
+// touched by the calling thread.
+static void *freeze_main(void *arg) {
+    subject_t *subject = arg;
+    scan_stats_t stats = {0};
+
+    pthread_mutex_lock(&subject->freeze_lock);
+    while (!subject->freeze_stopping) {
+        for (freeze_t *freeze=subject->freezes; freeze != NULL && !subject->freeze_paused; freeze = freeze->next) {
+            memory_write_spans(subject->pid, subject->memory_fd, &freeze->value, freeze->value_size, freeze->remote, freeze->span_count, &stats);
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        uint64_t nanoseconds = (uint64_t)deadline.tv_nsec + (uint64_t)subject->freeze_interval_ms * 1000000ull;
+        deadline.tv_sec += (time_t)(nanoseconds / 1000000000ull);
+        deadline.tv_nsec = (long)(nanoseconds % 1000000000ull);
+        pthread_cond_timedwait(&subject->freeze_wake, &subject->freeze_lock, &deadline);
+    }
+    pthread_mutex_unlock(&subject->freeze_lock);
+
+    return NULL;
+}
+
+
+// Unlinks the scan's freeze, the caller holds the freeze lock
+static freeze_t *take_freeze(subject_t *subject, scan_t *scan) {
+    for (freeze_t **link=&subject->freezes; *link != NULL; link = &(*link)->next) {
+        freeze_t *freeze = *link;
+        if (freeze->scan == scan) {
+            *link = freeze->next;
+            return freeze;
         }
     }
-    if (memory_fd != -1) {
-        close(memory_fd);
+    return NULL;
+}
+
+
+bool scan_freeze(scan_t *scan, ...) {
+    subject_t *subject = scan->subject;
+    if (scan_is_composite(scan)) {
+        fprintf(stderr, "error: string and group scans cannot be frozen\n");
+        return false;
+    }
+
+    freeze_t *freeze = calloc(1, sizeof(freeze_t));
+    if (freeze == NULL) {
+        fprintf(stderr, "error: out of memory while allocating freeze\n");
+        return false;
+    }
+
+    va_list args;
+    va_start(args, scan);
+    freeze->value = value_arg(scan->type, &args);
+    va_end(args);
+
+    // Addresses are fixed when the freeze starts, so each tick only writes
+    freeze->scan = scan;
+    freeze->value_size = scan_type_size(scan->type);
+    freeze->remote = malloc(MAX(scan->hits.count, 1) * sizeof(struct iovec));
+    if (freeze->remote == NULL) {
+        fprintf(stderr, "error: out of memory while allocating freeze\n");
+        free_freeze(freeze);
+        return false;
+    }
+    hit_iter_t iter;
+    size_t hit;
+    hit_iter_start(&iter, &scan->hits);
+    while (hit_iter_next(&iter, &hit)) {
+        freeze->remote[freeze->span_count].iov_base = (void *)hit;
+        freeze->remote[freeze->span_count].iov_len = freeze->value_size;
+        freeze->span_count++;
+    }
+
+    pthread_mutex_lock(&subject->freeze_lock);
+    free_freeze(take_freeze(subject, scan));
+    freeze->next = subject->freezes;
+    subject->freezes = freeze;
+
+    bool success = true;
+    if (!subject->freeze_running) {
+        int error = pthread_create(&subject->thread_id, NULL, freeze_main, subject);
+        if (error != 0) {
+            fprintf(stderr, "error: failed to start freeze thread: %s\n", strerror(error));
+            free_freeze(take_freeze(subject, scan));
+            success = false;
+        } else {
+            subject->freeze_running = true;
+        }
+    } else {
+        pthread_cond_signal(&subject->freeze_wake);
     }
+    pthread_mutex_unlock(&subject->freeze_lock);
 
     return success;
 }
 
 
+void scan_unfreeze(scan_t *scan) {
+    subject_t *subject = scan->subject;
+    pthread_mutex_lock(&subject->freeze_lock);
+    free_freeze(take_freeze(subject, scan));
+    pthread_mutex_unlock(&subject->freeze_lock);
+}
+
+
+void subject_set_freeze_interval(subject_t *subject, unsigned milliseconds) {
+    pthread_mutex_lock(&subject->freeze_lock);
+    subject->freeze_interval_ms = MAX(milliseconds, 1);
+    pthread_mutex_unlock(&subject->freeze_lock);
+}
+
+
 void scan_print(scan_t *scan) {
-    if (scan->hit_count == 0) {
+    hit_iter_t iter;
+    size_t hit;
+    hit_iter_start(&iter, &scan->hits);
+    if (scan->hits.count == 0) {
         printf("[0 hits] (No values matched)\n");
-    } else if(scan->hit_count == 1) {
-        printf("[1 hit]: 0x%lx\n", scan->hits[0]);
-    } else if (scan->hit_count < 32) {
-        printf("[%zu hits]:\n", scan->hit_count);
-        for (size_t i=0; i < scan->hit_count; i++) {
-            printf("0x%lx\n", scan->hits[i]);
+    } else if(scan->hits.count == 1) {
+        hit_iter_next(&iter, &hit);
+        printf("[1 hit]: 0x%lx\n", hit);
+    } else if (scan->hits.count < 32) {
+        printf("[%zu hits]:\n", scan->hits.count);
+        while (hit_iter_next(&iter, &hit)) {
+            printf("0x%lx\n", hit);
         }
     } else {
-        printf("[%zu hits] (Too many to list)\n", scan->hit_count);
+        printf("[%zu hits] (Too many to list)\n", scan->hits.count);
+    }
+}
+
+
+// Hands the hits of the scan to callback in batches together with the value
+// each had when it was last searched, so the whole result set never has to
+// be held at once. The subject is neither stopped nor read.
+bool scan_stream(scan_t *scan, scan_record_callback_t callback, void *context) {
+    if (scan->values.count != scan->hits.count) {
+        fprintf(stderr, "error: scan holds %zu values for %zu hits\n", scan->values.count, scan->hits.count);
+        return false;
+    }
+
+    scan_file_record_t *records = malloc(FILTER_BATCH_HITS * sizeof(scan_file_record_t));
+    if (records == NULL) {
+        fprintf(stderr, "error: out of memory while allocating stream batch\n");
+        return false;
+    }
+
+    bool success = true;
+    hit_iter_t iter;
+    size_t hit;
+    size_t index = 0;
+    size_t record_count = 0;
+    hit_iter_start(&iter, &scan->hits);
+    while (success && hit_iter_next(&iter, &hit)) {
+        set_record(&records[record_count++], hit, value_column_get(&scan->values, index++), scan->values.value_size);
+        if (record_count == FILTER_BATCH_HITS) {
+            success = callback(context, records, record_count);
+            record_count = 0;
+        }
+    }
+    if (success && record_count > 0) {
+        success = callback(context, records, record_count);
+    }
+    free(records);
+    return success;
+}
+
+
+static bool export_records(void *context, const scan_file_record_t *records, size_t count) {
+    return scan_writer_write(context, records, count);
+}
+
+
+bool scan_export(scan_t *scan, const char *path) {
+    // Records only hold eight bytes of value
+    if (scan_is_composite(scan)) {
+        fprintf(stderr, "error: string and group scans cannot be exported\n");
+        return false;
+    }
+    maps_t *maps = read_maps(scan->subject->pid);
+    if (maps == NULL) {
+        return false;
+    }
+
+    scan_writer_t writer;
+    bool success = scan_writer_open(&writer, path, scan->type, scan->alignment, scan->subject->pid, maps);
+    free_maps(maps);
+    if (!success) {
+        return false;
+    }
+    success = scan_stream(scan, export_records, &writer);
+    if (success && writer.header.record_count != scan->hits.count) {
+        fprintf(stderr, "error: exported %" PRIu64 " of %zu hits\n", writer.header.record_count, scan->hits.count);
+        success = false;
+    }
+    if (!scan_writer_close(&writer)) {
+        success = false;
+    }
+    return success;
+}
+
+
+// Creates a scan holding the hits and values of an exported scan file.
+// Records are read straight from the mapped file.
+scan_t *subject_import_scan(subject_t *subject, const char *path) {
+    scan_file_t *file = scan_file_open(path);
+    if (file == NULL) {
+        return NULL;
+    }
+
+    scan_t *scan = NULL;
+    const scan_file_header_t *header = file->header;
+    if (header->type > SCANTYPE_FLOAT64 || header->alignment == 0) {
+        fprintf(stderr, "error: '%s' has an invalid scan type or alignment\n", path);
+        goto EXIT;
+    }
+    if (header->pid != subject->pid) {
+        fprintf(stderr, "warning: '%s' was exported from pid %" PRId64 "\n", path, header->pid);
+    }
+
+    scan = subject_begin_scan(subject, (scan_type_e)header->type, header->alignment);
+    if (scan == NULL) {
+        goto EXIT;
+    }
+    for (uint64_t i=0; i < header->record_count; i++) {
+        const scan_file_record_t *record = &file->records[i];
+        if (i > 0 && record->address <= file->records[i - 1].address) {
+            fprintf(stderr, "error: '%s' has records out of order\n", path);
+            goto FAIL;
+        }
+        if (!hit_set_append(&scan->hits, record->address) || !value_column_append(&scan->values, record->value)) {
+            goto FAIL;
+        }
     }
+    scan->searched = true;
+    goto EXIT;
+
+  FAIL:
+    scan_free(scan);
+    scan = NULL;
+  EXIT:
+    scan_file_close(file);
+    return scan;
 }
 
 
@@ -617,10 +2992,14 @@ void scan_free(scan_t *scan) {
         return;
     }
 
+    scan_unfreeze(scan);
     pop_scan(scan);
 
-    if (scan->hits != NULL) {
-        free(scan->hits);
-    }
+    hit_set_clear(&scan->hits);
+    value_column_clear(&scan->values);
+    release_snapshot(scan->snapshot);
+    free(scan->zones);
+    free(scan->string);
+    free(scan->group);
     free(scan);
 }